@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <GL/glew.h>
+
+#include "main.h"
+#include "Benchmark.h"
+#include "ChunkCache.h"
+
+using namespace std;
+using namespace glm;
+
+
+CameraPath::CameraPath() :
+    points({
+        vec3(100.0f, 40.0f, 100.0f),        // Player spawn
+        vec3(500.0f, 55.0f, -100.0f),
+        vec3(900.0f, 45.0f, 200.0f),
+        vec3(700.0f, 60.0f, 700.0f),
+        vec3(200.0f, 50.0f, 600.0f)
+    }),
+    totalLength(0.0f)
+{
+    for (size_t i = 0; i < points.size(); i++) {
+        float length = distance(points[i], points[(i + 1) % points.size()]);
+        segmentLengths.push_back(length);
+        totalLength += length;
+    }
+}
+
+vec3 CameraPath::GetPosition(float distance) const {
+    int segment;
+    float t;
+    Locate(distance, segment, t);
+
+    return Evaluate(segment, t);
+}
+
+vec3 CameraPath::GetDirection(float distance) const {
+    int segment;
+    float t;
+    Locate(distance, segment, t);
+
+    // Look along the path, tilted down towards the terrain
+    vec3 tangent = Evaluate(segment, std::min(t + 0.01f, 1.0f)) - Evaluate(segment, std::max(t - 0.01f, 0.0f));
+    vec3 horizontal = normalize(vec3(tangent.x, 0.0f, tangent.z));
+
+    return normalize(horizontal + vec3(0.0f, -0.3f, 0.0f));
+}
+
+void CameraPath::Locate(float distance, int& segment, float& t) const {
+    distance = fmod(distance, totalLength);
+    if (distance < 0.0f) {
+        distance += totalLength;
+    }
+
+    segment = 0;
+    while (segment < (int)segmentLengths.size() - 1 && distance > segmentLengths[segment]) {
+        distance -= segmentLengths[segment];
+        segment++;
+    }
+    t = std::min(distance / segmentLengths[segment], 1.0f);
+}
+
+vec3 CameraPath::Evaluate(int segment, float t) const {
+    int count = (int)points.size();
+    const vec3& p0 = points[(segment + count - 1) % count];
+    const vec3& p1 = points[segment];
+    const vec3& p2 = points[(segment + 1) % count];
+    const vec3& p3 = points[(segment + 2) % count];
+
+    // Uniform Catmull-Rom, passes through every point
+    float t2 = t * t;
+    float t3 = t2 * t;
+    return 0.5f * (
+        2.0f * p1 +
+        (p2 - p0) * t +
+        (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+        (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3
+    );
+}
+
+
+BenchmarkSettings ParseBenchmarkArguments(int argc, char* argv[]) {
+    BenchmarkSettings settings;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--benchmark") == 0) {
+            settings.enabled = true;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            settings.frames = atoi(argv[++i]);
+            if (settings.frames <= 0) {
+                settings.valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            settings.outputPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache") == 0) {
+            settings.persistentCache = true;
+        }
+        else {
+            settings.valid = false;
+        }
+    }
+
+    if (!settings.valid) {
+        cerr << "Usage: " << argv[0] << " [--benchmark [--frames N] [--output file.json] [--cache]]" << endl;
+    }
+
+    return settings;
+}
+
+// Nearest rank percentile of already sorted values
+static double Percentile(const vector<double>& sorted, double percent) {
+    if (sorted.empty()) {
+        return 0.0;
+    }
+
+    size_t rank = (size_t)ceil(percent / 100.0 * sorted.size());
+    return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+// Write a JSON object summarising a set of samples
+static void WriteSummary(ostream& out, vector<double> values) {
+    sort(values.begin(), values.end());
+
+    double total = 0.0;
+    for (double value : values) {
+        total += value;
+    }
+
+    out << "{ \"count\": " << values.size()
+        << ", \"mean\": " << (values.empty() ? 0.0 : total / values.size())
+        << ", \"p50\": " << Percentile(values, 50.0)
+        << ", \"p95\": " << Percentile(values, 95.0)
+        << ", \"p99\": " << Percentile(values, 99.0)
+        << ", \"max\": " << (values.empty() ? 0.0 : values.back())
+        << " }";
+}
+
+bool WriteBenchmarkJson(
+    const string& path, const vector<BenchmarkFrame>& frames, int width, int height, int workerThreads,
+    const PrefetchStats& prefetch, const ChunkCache& chunkCache, bool persistentCache
+)
+{
+    ostringstream out;
+    out << fixed << setprecision(3);
+
+    // Samples for the summaries
+    vector<double> cpu;
+    vector<double> gpu;
+    vector<double> latency;
+    for (const BenchmarkFrame& frame : frames) {
+        cpu.push_back(frame.cpuMs);
+        if (frame.gpuMs >= 0.0) {
+            gpu.push_back(frame.gpuMs);
+        }
+        latency.insert(latency.end(), frame.chunkLatencyMs.begin(), frame.chunkLatencyMs.end());
+    }
+
+    out << "{\n";
+    out << "  \"frames\": " << frames.size() << ",\n";
+    out << "  \"width\": " << width << ",\n";
+    out << "  \"height\": " << height << ",\n";
+    out << "  \"renderMode\": " << TERRAIN_RENDER_MODE << ",\n";
+    out << "  \"renderDistance\": " << RENDER_DISTANCE << ",\n";
+    out << "  \"workerThreads\": " << workerThreads << ",\n";
+    out << "  \"prefetch\": { \"hits\": " << prefetch.hits << ", \"misses\": " << prefetch.misses
+        << ", \"wasted\": " << prefetch.wasted << " },\n";
+
+    // Where requested chunks came from (still loaded, either cache tier or generated), as counts and rates
+    const ChunkCacheStats& cache = chunkCache.GetStats();
+    int lookups = cache.residentHits + cache.ramHits + cache.diskHits + cache.misses;
+    auto rate = [lookups](int count) { return lookups > 0 ? (double)count / lookups : 0.0; };
+    out << "  \"chunkCache\": { \"persistent\": " << (persistentCache ? "true" : "false")
+        << ", \"residentHits\": " << cache.residentHits << ", \"ramHits\": " << cache.ramHits
+        << ", \"diskHits\": " << cache.diskHits << ", \"misses\": " << cache.misses
+        << ", \"residentRate\": " << rate(cache.residentHits) << ", \"ramRate\": " << rate(cache.ramHits)
+        << ", \"diskRate\": " << rate(cache.diskHits) << ", \"missRate\": " << rate(cache.misses)
+        << ", \"ramBytes\": " << chunkCache.GetRamBytes() << ", \"diskBytes\": " << chunkCache.GetDiskBytes()
+        << ", \"fileEntries\": " << chunkCache.GetFileEntries() << " },\n";
+
+    // State changes over the whole run, by kind
+    GLStateStats glState;
+    for (const BenchmarkFrame& frame : frames) {
+        for (int call = 0; call < STATE_CALL_TYPES; call++) {
+            glState.issued[call] += frame.glState.issued[call];
+            glState.elided[call] += frame.glState.elided[call];
+        }
+    }
+    out << "  \"glState\": {";
+    for (int call = 0; call < STATE_CALL_TYPES; call++) {
+        out << (call > 0 ? "," : "") << " \"" << GetStateCallName((GLStateCall)call) << "\": { \"issued\": "
+            << glState.issued[call] << ", \"elided\": " << glState.elided[call] << " }";
+    }
+    out << " },\n";
+
+    out << "  \"summary\": {\n";
+    out << "    \"cpuMs\": ";
+    WriteSummary(out, cpu);
+    out << ",\n    \"gpuMs\": ";
+    WriteSummary(out, gpu);
+    out << ",\n    \"chunkLatencyMs\": ";
+    WriteSummary(out, latency);
+    out << "\n  },\n";
+
+    out << "  \"perFrame\": [\n";
+    for (size_t i = 0; i < frames.size(); i++) {
+        const BenchmarkFrame& frame = frames[i];
+
+        out << "    { \"frame\": " << i
+            << ", \"cpuMs\": " << frame.cpuMs
+            << ", \"gpuMs\": " << frame.gpuMs
+            << ", \"chunkLatencyMs\": [";
+        for (size_t j = 0; j < frame.chunkLatencyMs.size(); j++) {
+            out << (j > 0 ? ", " : "") << frame.chunkLatencyMs[j];
+        }
+        out << "]"
+            << ", \"terrainChunksDrawn\": " << frame.terrainChunksDrawn
+            << ", \"terrainChunksCulled\": " << frame.terrainChunksCulled
+            << ", \"terrainPatchesCulled\": " << frame.terrainPatchesCulled
+            << ", \"waterChunksDrawn\": " << frame.waterChunksDrawn
+            << ", \"waterChunksCulled\": " << frame.waterChunksCulled
+            << ", \"glStateIssued\": {";
+        for (int call = 0; call < STATE_CALL_TYPES; call++) {
+            out << (call > 0 ? ", " : " ") << "\"" << GetStateCallName((GLStateCall)call) << "\": " << frame.glState.issued[call];
+        }
+        out << " }, \"glStateElided\": {";
+        for (int call = 0; call < STATE_CALL_TYPES; call++) {
+            out << (call > 0 ? ", " : " ") << "\"" << GetStateCallName((GLStateCall)call) << "\": " << frame.glState.elided[call];
+        }
+        out << " } }" << (i + 1 < frames.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+
+    if (path.empty()) {
+        cout << out.str();
+        return true;
+    }
+
+    ofstream file(path);
+    if (!file) {
+        cerr << "Failed to write benchmark results: " << path << endl;
+        return false;
+    }
+    file << out.str();
+    return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <string>
+#include <vector>
+
+#include <glm/glm/ext/vector_float3.hpp>
+
+#include "GLStateCache.h"
+
+using namespace std;
+using namespace glm;
+
+
+struct PrefetchStats;
+class ChunkCache;
+
+
+// Define benchmark constants
+const int BENCHMARK_DEFAULT_FRAMES = 1000;
+const float BENCHMARK_FRAME_TIME = 1.0f / 60.0f;    // Fixed simulation step, keeps runs deterministic
+const float BENCHMARK_CAMERA_SPEED = 40.0f;         // World units per second along the camera path
+const int BENCHMARK_QUERY_FRAMES = 4;               // GPU timer queries in flight, results are read this many frames late
+
+
+// Command line options, e.g. --benchmark --frames 2000 --output results.json
+struct BenchmarkSettings {
+    bool enabled;
+    bool valid;                 // False when the arguments could not be parsed
+    int frames;
+    string outputPath;          // Empty writes to stdout
+    bool persistentCache;       // Start from and save the chunk cache file (--cache), off so every run starts the same
+
+    BenchmarkSettings() : enabled(false), valid(true), frames(BENCHMARK_DEFAULT_FRAMES), persistentCache(false) {}
+};
+
+// Measurements for one benchmark frame
+struct BenchmarkFrame {
+    double cpuMs;               // Update and Render on the CPU, including buffer swap
+    double gpuMs;               // GL_TIME_ELAPSED of the frame's GL commands, negative if the query never resolved
+    vector<double> chunkLatencyMs;      // Request to upload time of every chunk uploaded this frame
+    int terrainChunksDrawn;
+    int terrainChunksCulled;
+    int terrainPatchesCulled;
+    int waterChunksDrawn;
+    int waterChunksCulled;
+    GLStateStats glState;       // State changes issued and dropped as redundant while updating and rendering
+
+    BenchmarkFrame() :
+        cpuMs(0.0), gpuMs(-1.0),
+        terrainChunksDrawn(0), terrainChunksCulled(0), terrainPatchesCulled(0),
+        waterChunksDrawn(0), waterChunksCulled(0)
+    {}
+};
+
+
+// Deterministic camera flight, a closed Catmull-Rom spline through fixed points above the terrain
+class CameraPath {
+public:
+    CameraPath();
+
+    // Position and view direction after travelling the given distance along the path (loops)
+    vec3 GetPosition(float distance) const;
+    vec3 GetDirection(float distance) const;
+
+private:
+    // Segment and parameter within it after travelling the given distance
+    void Locate(float distance, int& segment, float& t) const;
+    vec3 Evaluate(int segment, float t) const;
+
+    vector<vec3> points;
+    vector<float> segmentLengths;   // Chord lengths, close enough to arc length for steady camera speed
+    float totalLength;
+};
+
+
+// Function to read benchmark options from the command line
+BenchmarkSettings ParseBenchmarkArguments(int argc, char* argv[]);
+
+// Function to write per frame measurements and p50/p95/p99 summaries as JSON, to stdout when path is empty
+bool WriteBenchmarkJson(
+    const string& path, const vector<BenchmarkFrame>& frames, int width, int height, int workerThreads,
+    const PrefetchStats& prefetch, const ChunkCache& chunkCache, bool persistentCache
+);
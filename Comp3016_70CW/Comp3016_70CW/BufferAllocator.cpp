@@ -0,0 +1,74 @@
+#include <algorithm>
+
+#include "BufferAllocator.h"
+
+using namespace std;
+
+
+BufferAllocator::BufferAllocator(int capacity) :
+    capacity(0),
+    used(0)
+{
+    Reset(capacity);
+}
+
+void BufferAllocator::Reset(int newCapacity) {
+    capacity = newCapacity;
+    used = 0;
+    freeRanges.clear();
+    allocations.clear();
+
+    if (capacity > 0) {
+        freeRanges.push_back(Range{ 0, capacity });
+    }
+}
+
+int BufferAllocator::Allocate(int size) {
+    if (size <= 0) {
+        return -1;
+    }
+
+    // First fit, taking the front of the range so the rest stays in place
+    for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+        if (it->size < size) {
+            continue;
+        }
+
+        int offset = it->offset;
+        it->offset += size;
+        it->size -= size;
+        if (it->size == 0) {
+            freeRanges.erase(it);
+        }
+
+        allocations[offset] = size;
+        used += size;
+        return offset;
+    }
+
+    return -1;
+}
+
+void BufferAllocator::Free(int offset) {
+    auto allocation = allocations.find(offset);
+    if (allocation == allocations.end()) {
+        return;
+    }
+    int size = allocation->second;
+    allocations.erase(allocation);
+    used -= size;
+
+    // Insert in offset order, then merge with whichever neighbours it touches
+    auto next = lower_bound(freeRanges.begin(), freeRanges.end(), offset,
+        [](const Range& range, int value) { return range.offset < value; });
+    auto it = freeRanges.insert(next, Range{ offset, size });
+
+    if (it + 1 != freeRanges.end() && it->offset + it->size == (it + 1)->offset) {
+        it->size += (it + 1)->size;
+        freeRanges.erase(it + 1);
+    }
+    if (it != freeRanges.begin() && (it - 1)->offset + (it - 1)->size == it->offset) {
+        (it - 1)->size += it->size;
+        freeRanges.erase(it);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+
+// Free list suballocator handing out ranges of one large GPU buffer. Only keeps the books, offsets and sizes
+// are in whatever unit the caller picks (terrain uses vertices, so an offset can be used as a base vertex).
+// Free ranges are kept sorted and merged with their neighbours, allocation takes the first range that fits.
+class BufferAllocator {
+public:
+    explicit BufferAllocator(int capacity = 0);
+
+    // Forget every allocation and start again with one free range of the given size
+    void Reset(int capacity);
+
+    // Offset of a newly allocated range, or -1 when no free range is large enough
+    int Allocate(int size);
+
+    // Return a range given out by Allocate
+    void Free(int offset);
+
+    // Getters
+    int GetCapacity() const { return capacity; }
+    int GetUsed() const { return used; }
+
+private:
+    struct Range {
+        int offset;
+        int size;
+    };
+
+    int capacity;
+    int used;
+    vector<Range> freeRanges;               // Sorted by offset, never touching each other
+    unordered_map<int, int> allocations;    // Offset to size of every range given out
+};
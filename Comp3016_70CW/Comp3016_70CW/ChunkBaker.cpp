@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "main.h"
+#include "ChunkCache.h"
+
+using namespace std;
+
+
+// Offline chunk baker: generates a rectangle of chunks on every core with the game's own generation and meshing code,
+// and saves their heightfields to the chunk cache file the game maps at startup. No window or GL context is created.
+// Also reports generation throughput, so it doubles as a benchmark for the noise and meshing code.
+
+
+// Define baker constants
+const int BAKER_DEFAULT_RADIUS = 8;     // Chunks in each direction from the origin when no region is given
+
+
+struct BakerSettings {
+    bool valid;                 // False when the arguments could not be parsed
+    int minX;                   // Region of chunks to bake, inclusive
+    int minZ;
+    int maxX;
+    int maxZ;
+    int threadCount;            // 0 uses every hardware thread
+    bool buildMeshes;           // Mesh every chunk like the game's workers do, only for timing as meshes are not cached
+    string directory;
+
+    BakerSettings() :
+        valid(true),
+        minX(-BAKER_DEFAULT_RADIUS),
+        minZ(-BAKER_DEFAULT_RADIUS),
+        maxX(BAKER_DEFAULT_RADIUS),
+        maxZ(BAKER_DEFAULT_RADIUS),
+        threadCount(0),
+        buildMeshes(true),
+        directory(CHUNK_CACHE_DIRECTORY)
+    {}
+};
+
+// Compressed heightfield of one baked chunk
+struct BakedChunk {
+    int chunkX;
+    int chunkZ;
+    vector<uint8_t> compressed;
+};
+
+
+static BakerSettings ParseBakerArguments(int argc, char* argv[]) {
+    BakerSettings settings;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--region") == 0 && i + 4 < argc) {
+            settings.minX = atoi(argv[++i]);
+            settings.minZ = atoi(argv[++i]);
+            settings.maxX = atoi(argv[++i]);
+            settings.maxZ = atoi(argv[++i]);
+            if (settings.minX > settings.maxX || settings.minZ > settings.maxZ) {
+                settings.valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            settings.threadCount = atoi(argv[++i]);
+            if (settings.threadCount <= 0) {
+                settings.valid = false;
+            }
+        }
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            settings.directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--heights-only") == 0) {
+            settings.buildMeshes = false;
+        }
+        else {
+            settings.valid = false;
+        }
+    }
+
+    if (!settings.valid) {
+        cerr << "Usage: " << argv[0] << " [--region minX minZ maxX maxZ] [--threads N] [--output directory] [--heights-only]" << endl;
+    }
+
+    return settings;
+}
+
+// Generate, optionally mesh, and compress chunks[next] until every chunk is taken
+static void BakeChunks(const BakerSettings& settings, vector<BakedChunk>& chunks, atomic<int>& next) {
+    // Meshes are written with 16 byte non-temporal stores, so the scratch buffer is aligned like a staging slot
+    vector<uint8_t> scratch(settings.buildMeshes ? (size_t)TERRAIN_CHUNK_VERTICES * TERRAIN_VERTEX_SIZE + 64 : 0);
+    void* vertices = (void*)(((uintptr_t)scratch.data() + 63) & ~(uintptr_t)63);
+
+    for (int index = next++; index < (int)chunks.size(); index = next++) {
+        BakedChunk& chunk = chunks[index];
+
+        // Without neighbours every border sample is generated, the same heights the game would share
+        shared_ptr<const ChunkHeightfield> heightfield = BuildHeightfield(chunk.chunkX, chunk.chunkZ, ChunkNeighbours());
+        if (settings.buildMeshes) {
+            BuildTerrainMesh(heightfield, vertices);
+        }
+        chunk.compressed = CompressHeightfield(*heightfield);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    BakerSettings settings = ParseBakerArguments(argc, argv);
+    if (!settings.valid) {
+        return 1;
+    }
+
+    // Furthest from the region's centre first, so the centre ends up most recently used and is the last to be evicted
+    vector<BakedChunk> chunks;
+    for (int z = settings.minZ; z <= settings.maxZ; z++) {
+        for (int x = settings.minX; x <= settings.maxX; x++) {
+            chunks.push_back({ x, z, vector<uint8_t>() });
+        }
+    }
+    int centreX2 = settings.minX + settings.maxX;
+    int centreZ2 = settings.minZ + settings.maxZ;
+    auto distance = [centreX2, centreZ2](const BakedChunk& chunk) {
+        return std::max(abs(2 * chunk.chunkX - centreX2), abs(2 * chunk.chunkZ - centreZ2));
+    };
+    stable_sort(chunks.begin(), chunks.end(), [&distance](const BakedChunk& a, const BakedChunk& b) {
+        return distance(a) > distance(b);
+    });
+
+    int threadCount = settings.threadCount > 0 ? settings.threadCount : std::max(1, (int)thread::hardware_concurrency());
+
+    // -=-=- Generate -=-=-
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    atomic<int> next(0);
+    vector<thread> workers;
+    for (int i = 0; i < threadCount; i++) {
+        workers.emplace_back(BakeChunks, cref(settings), ref(chunks), ref(next));
+    }
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+    double generateSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // -=-=- Save -=-=-
+    // Chunks already in the cache file are kept, the budgets only limit what the game holds
+    ChunkCache cache(numeric_limits<size_t>::max(), numeric_limits<size_t>::max(), settings.directory);
+    cache.Load();
+    for (BakedChunk& chunk : chunks) {
+        cache.Store(chunk.chunkX, chunk.chunkZ, move(chunk.compressed));
+    }
+    bool saved = cache.Save();
+
+    double totalSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    // -=-=- Report -=-=-
+    double samples = (double)chunks.size() * HEIGHTFIELD_SIZE * HEIGHTFIELD_SIZE;
+    cout << fixed << setprecision(3);
+    cout << "Baked " << chunks.size() << " chunks (" << settings.minX << ", " << settings.minZ << " to "
+        << settings.maxX << ", " << settings.maxZ << ") on " << threadCount << " threads" << endl;
+    cout << "Generation: " << generateSeconds << " s, " << chunks.size() / generateSeconds << " chunks/s, "
+        << samples / generateSeconds / 1.0e6 << " M samples/s" << (settings.buildMeshes ? ", meshes included" : "") << endl;
+    cout << "Total with saving: " << totalSeconds << " s" << endl;
+
+    if (!saved) {
+        cerr << "Failed to write the chunk cache to " << settings.directory << endl;
+        return 1;
+    }
+    cout << "Cache file holds " << cache.GetFileEntries() << " chunks, " << cache.GetDiskBytes() / (1024.0 * 1024.0) << " MB" << endl;
+    return 0;
+}
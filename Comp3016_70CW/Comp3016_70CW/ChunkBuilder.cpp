@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "ChunkBuilder.h"
+
+using namespace std;
+
+
+ChunkBuilder::ChunkBuilder() :
+    focusX(0),
+    focusZ(0),
+    stopping(false),
+    finishedHead(nullptr)
+{}
+
+ChunkBuilder::~ChunkBuilder() {
+    Stop();
+
+    // Free any finished chunks that were never collected
+    BuiltChunk* node = finishedHead.exchange(nullptr);
+    while (node) {
+        BuiltChunk* next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+void ChunkBuilder::Start(int threadCount) {
+    if (!workers.empty()) {
+        return;
+    }
+
+    // Leave one hardware thread free for the render thread
+    if (threadCount <= 0) {
+        threadCount = std::max(1, (int)thread::hardware_concurrency() - 1);
+    }
+
+    stopping = false;
+    for (int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ChunkBuilder::WorkerLoop, this);
+    }
+}
+
+void ChunkBuilder::Stop() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+        requests.clear();
+    }
+    queueCondition.notify_all();
+
+    // Wake workers waiting for mesh space too, taking the lock so none can miss the notify between checking and waiting
+    {
+        lock_guard<mutex> lock(spaceMutex);
+    }
+    spaceCondition.notify_all();
+
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+}
+
+void ChunkBuilder::Request(int chunkX, int chunkZ, const ChunkNeighbours& neighbours, const ChunkCacheLookup& cached) {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        requests.push_back({ chunkX, chunkZ, neighbours, cached });
+    }
+    queueCondition.notify_one();
+}
+
+void ChunkBuilder::CancelOutside(int centreX, int centreZ, int distance) {
+    lock_guard<mutex> lock(queueMutex);
+
+    requests.erase(remove_if(requests.begin(), requests.end(), [&](const ChunkRequest& request) {
+        return abs(request.chunkX - centreX) > distance || abs(request.chunkZ - centreZ) > distance;
+    }), requests.end());
+}
+
+void ChunkBuilder::ProvideMeshSpace(int slot, void* data) {
+    {
+        lock_guard<mutex> lock(spaceMutex);
+        meshSpace.push_back({ slot, data });
+    }
+    spaceCondition.notify_one();
+}
+
+void ChunkBuilder::SetFocus(int chunkX, int chunkZ) {
+    lock_guard<mutex> lock(queueMutex);
+    focusX = chunkX;
+    focusZ = chunkZ;
+}
+
+vector<TerrainMeshData> ChunkBuilder::TakeFinished() {
+    vector<TerrainMeshData> finished;
+
+    // Detach the whole stack in one go, workers can keep pushing onto the now empty head
+    BuiltChunk* node = finishedHead.exchange(nullptr, memory_order_acquire);
+
+    // Stack is newest first, collect then reverse so chunks are uploaded in completion order
+    while (node) {
+        BuiltChunk* next = node->next;
+        finished.push_back(move(node->mesh));
+        delete node;
+        node = next;
+    }
+    reverse(finished.begin(), finished.end());
+
+    return finished;
+}
+
+void ChunkBuilder::WorkerLoop() {
+    while (true) {
+        ChunkRequest request;
+
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+
+            if (stopping) {
+                return;
+            }
+
+            // Take the request closest to the focus chunk, the queue only ever holds a few
+            // hundred entries so a linear scan is cheaper than keeping a heap re-sorted on every camera move
+            auto distance = [this](const ChunkRequest& r) {
+                int dx = r.chunkX - focusX;
+                int dz = r.chunkZ - focusZ;
+                return dx * dx + dz * dz;
+            };
+            auto nearest = min_element(requests.begin(), requests.end(), [&](const ChunkRequest& a, const ChunkRequest& b) {
+                return distance(a) < distance(b);
+            });
+
+            request = *nearest;
+            requests.erase(nearest);
+        }
+
+        // Decompress or generate heights outside of the lock, falling back to generating when a cached copy is unreadable
+        shared_ptr<const ChunkHeightfield> heightfield;
+        if (request.cached.data) {
+            heightfield = DecompressHeightfield(request.chunkX, request.chunkZ, request.cached.data, request.cached.bytes);
+        }
+        else if (!request.cached.path.empty()) {
+            heightfield = LoadCachedHeightfield(request.chunkX, request.chunkZ, request.cached.path);
+        }
+        if (!heightfield) {
+            heightfield = BuildHeightfield(request.chunkX, request.chunkZ, request.neighbours);
+        }
+
+        // Then mesh straight into mapped memory, once the GL thread has some free
+        MeshSpace space = { -1, nullptr };
+        if (TERRAIN_RENDER_MODE != TERRAIN_HEIGHTMAP_TEXTURE) {
+            unique_lock<mutex> lock(spaceMutex);
+            spaceCondition.wait(lock, [this] { return stopping || !meshSpace.empty(); });
+
+            if (stopping) {
+                return;
+            }
+
+            space = meshSpace.back();
+            meshSpace.pop_back();
+        }
+
+        BuiltChunk* node = new BuiltChunk;
+        node->mesh = BuildTerrainMesh(heightfield, space.data);
+        node->mesh.stagingSlot = space.slot;
+
+        // Push onto the completion stack
+        node->next = finishedHead.load(memory_order_relaxed);
+        while (!finishedHead.compare_exchange_weak(node->next, node, memory_order_release, memory_order_relaxed)) {}
+    }
+}
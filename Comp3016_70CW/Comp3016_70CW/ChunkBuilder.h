@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "main.h"
+#include "ChunkCache.h"
+
+using namespace std;
+
+
+// Chunk waiting to be generated by a worker thread
+struct ChunkRequest {
+    int chunkX;
+    int chunkZ;
+    ChunkNeighbours neighbours;     // Loaded neighbours to copy shared border heights from
+    ChunkCacheLookup cached;        // Cached heightfield to rebuild from instead of generating one
+};
+
+// Mapped memory for one chunk mesh, handed to the workers in advance by the GL thread
+struct MeshSpace {
+    int slot;
+    void* data;                 // TERRAIN_CHUNK_VERTICES * TERRAIN_VERTEX_SIZE bytes, 16 byte aligned
+};
+
+// Finished chunk mesh, handed back to the GL thread through the completion queue
+struct BuiltChunk {
+    TerrainMeshData mesh;
+    BuiltChunk* next;           // Intrusive link used by the lock-free completion queue
+};
+
+
+// Pool of worker threads that generate terrain chunk meshes off the render thread.
+// Requests are taken nearest-first relative to the current focus chunk, finished meshes are
+// pushed onto a lock-free stack which the GL thread drains once per frame to upload them.
+// Meshes are built straight into mesh space the GL thread provides, a worker waits when there is none free.
+class ChunkBuilder {
+public:
+    ChunkBuilder();
+    ~ChunkBuilder();
+
+    // Start worker threads, 0 = one per hardware thread minus the render thread
+    void Start(int threadCount = 0);
+
+    // Stop and join all worker threads, any queued requests are dropped
+    void Stop();
+
+    // Queue a chunk for generation, from its cached heightfield when there is one
+    void Request(int chunkX, int chunkZ, const ChunkNeighbours& neighbours, const ChunkCacheLookup& cached = ChunkCacheLookup());
+
+    // Remove queued (not yet started) requests further than the given distance from the chunk
+    void CancelOutside(int centreX, int centreZ, int distance);
+
+    // Give the workers mapped memory to build one mesh into, it comes back as the mesh's staging slot and
+    // data. Not needed for TERRAIN_HEIGHTMAP_TEXTURE, which has no meshes.
+    void ProvideMeshSpace(int slot, void* data);
+
+    // Set the chunk used to prioritise queued requests (usually the camera chunk)
+    void SetFocus(int chunkX, int chunkZ);
+
+    // Take every finished chunk mesh, oldest first
+    vector<TerrainMeshData> TakeFinished();
+
+    // Getters
+    int GetThreadCount() const { return (int)workers.size(); }
+
+private:
+    void WorkerLoop();
+
+    vector<thread> workers;
+
+    // Request queue, shared with workers under queueMutex
+    mutex queueMutex;
+    condition_variable queueCondition;
+    vector<ChunkRequest> requests;
+    int focusX;
+    int focusZ;
+    atomic<bool> stopping;
+
+    // Free mesh space, shared with workers under spaceMutex
+    mutex spaceMutex;
+    condition_variable spaceCondition;
+    vector<MeshSpace> meshSpace;
+
+    // Lock-free completion queue (multi-producer stack, drained in one exchange by the GL thread)
+    atomic<BuiltChunk*> finishedHead;
+};
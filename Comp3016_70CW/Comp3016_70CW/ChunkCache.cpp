@@ -0,0 +1,462 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "ChunkCache.h"
+#include "Noise.h"
+
+using namespace std;
+
+
+// Cache file layout: the header, entryCount index entries, then the compressed heightfields they point at
+struct ChunkCacheFileHeader {
+    char magic[4];              // "CHNK"
+    uint32_t version;           // CHUNK_CACHE_FILE_VERSION
+    uint64_t parameters;        // HashGenerationParameters() of the run that wrote it
+    int32_t chunkSize;          // CHUNK_SIZE and TILE_SIZE of that run, also part of the hash
+    float tileSize;
+    uint32_t entryCount;
+    uint32_t reserved;
+};
+
+struct ChunkCacheFileEntry {
+    int32_t chunkX;
+    int32_t chunkZ;
+    uint32_t bytes;
+    uint32_t reserved;
+    uint64_t offset;            // From the start of the file
+};
+
+const uint32_t CHUNK_CACHE_FILE_VERSION = 2;
+const char* const CHUNK_CACHE_FILE_NAME = "chunks.bin";
+
+
+ChunkCache::ChunkCache(size_t ramBudget, size_t diskBudget, const string& directory) :
+    ramBudget(ramBudget),
+    diskBudget(diskBudget),
+    directory(directory),
+    directoryCreated(false),
+    fileEntries(0),
+    ramBytes(0),
+    diskBytes(0)
+{}
+
+ChunkCache::~ChunkCache() {
+    Clear();
+}
+
+void ChunkCache::Load() {
+    Clear();
+
+    shared_ptr<MappedFile> mapped = make_shared<MappedFile>();
+    if (!mapped->Open(GetFilePath())) {
+        return;
+    }
+
+    // Anything unexpected means a stale or damaged file, it is replaced by the next save
+    const uint8_t* data = mapped->GetData();
+    size_t size = mapped->GetSize();
+    if (size < sizeof(ChunkCacheFileHeader)) {
+        return;
+    }
+    ChunkCacheFileHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    bool valid = memcmp(header.magic, "CHNK", 4) == 0 && header.version == CHUNK_CACHE_FILE_VERSION &&
+        header.parameters == HashGenerationParameters() && header.chunkSize == CHUNK_SIZE && header.tileSize == TILE_SIZE &&
+        header.entryCount <= (size - sizeof(header)) / sizeof(ChunkCacheFileEntry);
+    if (!valid) {
+        return;
+    }
+
+    // Index entries are in recency order, most recent first
+    for (uint32_t i = 0; i < header.entryCount; i++) {
+        ChunkCacheFileEntry fileEntry;
+        memcpy(&fileEntry, data + sizeof(header) + i * sizeof(fileEntry), sizeof(fileEntry));
+
+        int64_t key = Key(fileEntry.chunkX, fileEntry.chunkZ);
+        if (fileEntry.offset > size || fileEntry.bytes > size - fileEntry.offset || entries.count(key)) {
+            continue;
+        }
+
+        Entry entry;
+        entry.chunkX = fileEntry.chunkX;
+        entry.chunkZ = fileEntry.chunkZ;
+        entry.tier = CHUNK_CACHE_DISK;
+        entry.fileOffset = (size_t)fileEntry.offset;
+        entry.bytes = fileEntry.bytes;
+        diskOrder.push_back(key);
+        entry.order = prev(diskOrder.end());
+        diskBytes += entry.bytes;
+        entries[key] = entry;
+    }
+
+    file = mapped;
+    fileEntries = (int)entries.size();
+    EnforceBudgets();
+}
+
+bool ChunkCache::Save() {
+    // Most recently used first, from memory then disk, until the disk budget is used up
+    vector<const Entry*> saved;
+    size_t savedBytes = 0;
+    for (const list<int64_t>* order : { &ramOrder, &diskOrder }) {
+        for (int64_t key : *order) {
+            const Entry& entry = entries.at(key);
+            if (savedBytes + entry.bytes > diskBudget) {
+                break;
+            }
+            saved.push_back(&entry);
+            savedBytes += entry.bytes;
+        }
+    }
+
+    // Written next to the old file, which may still be mapped and read from while writing
+    EnsureDirectory();
+    string path = GetFilePath();
+    string temporaryPath = path + ".tmp";
+    bool written;
+    {
+        ofstream out(temporaryPath, ios::binary | ios::trunc);
+
+        ChunkCacheFileHeader header = {};
+        memcpy(header.magic, "CHNK", 4);
+        header.version = CHUNK_CACHE_FILE_VERSION;
+        header.parameters = HashGenerationParameters();
+        header.chunkSize = CHUNK_SIZE;
+        header.tileSize = TILE_SIZE;
+        header.entryCount = (uint32_t)saved.size();
+        out.write((const char*)&header, sizeof(header));
+
+        uint64_t offset = sizeof(header) + saved.size() * sizeof(ChunkCacheFileEntry);
+        for (const Entry* entry : saved) {
+            ChunkCacheFileEntry fileEntry = {};
+            fileEntry.chunkX = entry->chunkX;
+            fileEntry.chunkZ = entry->chunkZ;
+            fileEntry.bytes = (uint32_t)entry->bytes;
+            fileEntry.offset = offset;
+            out.write((const char*)&fileEntry, sizeof(fileEntry));
+            offset += entry->bytes;
+        }
+
+        for (const Entry* entry : saved) {
+            if (entry->tier == CHUNK_CACHE_RAM) {
+                out.write((const char*)entry->data->data(), entry->bytes);
+            }
+            else if (entry->fileOffset != NOT_IN_FILE) {
+                out.write((const char*)file->GetData() + entry->fileOffset, entry->bytes);
+            }
+            else {
+                // A file that went missing leaves a hole that fails to decompress, and the chunk is generated again
+                vector<char> spilled(entry->bytes);
+                ifstream in(GetSpillPath(entry->chunkX, entry->chunkZ), ios::binary);
+                in.read(spilled.data(), spilled.size());
+                out.write(spilled.data(), spilled.size());
+            }
+        }
+        written = (bool)out;
+    }
+
+    // The old file must be unmapped before it can be replaced
+    Clear();
+    if (written) {
+        remove(path.c_str());
+        written = rename(temporaryPath.c_str(), path.c_str()) == 0;
+    }
+    if (!written) {
+        remove(temporaryPath.c_str());
+    }
+
+    Load();
+    return written;
+}
+
+void ChunkCache::Store(const ChunkHeightfield& field) {
+    auto existing = entries.find(Key(field.chunkX, field.chunkZ));
+    if (existing != entries.end()) {
+        // Still in memory or the cache file from the last time it was unloaded, only its recency changes
+        Entry& entry = existing->second;
+        if (entry.tier == CHUNK_CACHE_RAM) {
+            ramOrder.splice(ramOrder.begin(), ramOrder, entry.order);
+            return;
+        }
+        if (entry.fileOffset != NOT_IN_FILE) {
+            diskOrder.splice(diskOrder.begin(), diskOrder, entry.order);
+            return;
+        }
+    }
+
+    Store(field.chunkX, field.chunkZ, CompressHeightfield(field));
+}
+
+void ChunkCache::Store(int chunkX, int chunkZ, vector<uint8_t> compressed) {
+    auto existing = entries.find(Key(chunkX, chunkZ));
+    if (existing != entries.end()) {
+        Remove(existing);
+    }
+
+    Entry entry;
+    entry.chunkX = chunkX;
+    entry.chunkZ = chunkZ;
+    entry.tier = CHUNK_CACHE_RAM;
+    entry.data = make_shared<const vector<uint8_t>>(move(compressed));
+    entry.fileOffset = NOT_IN_FILE;
+    entry.bytes = entry.data->size();
+
+    int64_t key = Key(chunkX, chunkZ);
+    ramOrder.push_front(key);
+    entry.order = ramOrder.begin();
+    ramBytes += entry.bytes;
+    entries[key] = entry;
+
+    EnforceBudgets();
+}
+
+ChunkCacheLookup ChunkCache::Find(int chunkX, int chunkZ) {
+    ChunkCacheLookup lookup;
+
+    auto it = entries.find(Key(chunkX, chunkZ));
+    if (it == entries.end()) {
+        stats.misses++;
+        return lookup;
+    }
+
+    // Workers read the data in place, the owner keeps it from being freed or unmapped while they do
+    Entry& entry = it->second;
+    lookup.tier = entry.tier;
+    lookup.bytes = entry.bytes;
+    if (entry.tier == CHUNK_CACHE_RAM) {
+        ramOrder.splice(ramOrder.begin(), ramOrder, entry.order);
+        lookup.data = entry.data->data();
+        lookup.owner = entry.data;
+        stats.ramHits++;
+    }
+    else {
+        diskOrder.splice(diskOrder.begin(), diskOrder, entry.order);
+        if (entry.fileOffset != NOT_IN_FILE) {
+            lookup.data = file->GetData() + entry.fileOffset;
+            lookup.owner = file;
+        }
+        else {
+            lookup.path = GetSpillPath(chunkX, chunkZ);
+        }
+        stats.diskHits++;
+    }
+    return lookup;
+}
+
+void ChunkCache::Clear() {
+    while (!entries.empty()) {
+        Remove(entries.begin());
+    }
+    file.reset();
+    fileEntries = 0;
+}
+
+string ChunkCache::GetSpillPath(int chunkX, int chunkZ) const {
+    return directory + "/chunk_" + to_string(chunkX) + "_" + to_string(chunkZ) + ".bin";
+}
+
+string ChunkCache::GetFilePath() const {
+    return directory + "/" + CHUNK_CACHE_FILE_NAME;
+}
+
+void ChunkCache::EnsureDirectory() {
+    if (directoryCreated) {
+        return;
+    }
+#ifdef _WIN32
+    _mkdir(directory.c_str());
+#else
+    mkdir(directory.c_str(), 0755);
+#endif
+    directoryCreated = true;
+}
+
+void ChunkCache::EnforceBudgets() {
+    // Spill from memory to disk, always keeping the newest entry so a tiny budget still caches something
+    while (ramBytes > ramBudget && ramOrder.size() > 1) {
+        auto it = entries.find(ramOrder.back());
+        Entry& entry = it->second;
+
+        // Write the file, dropping the entry instead if that fails or the disk tier has no room at all
+        bool written = false;
+        if (entry.bytes <= diskBudget) {
+            EnsureDirectory();
+            ofstream spill(GetSpillPath(entry.chunkX, entry.chunkZ), ios::binary | ios::trunc);
+            spill.write((const char*)entry.data->data(), entry.data->size());
+            written = (bool)spill;
+        }
+        if (!written) {
+            Remove(it);
+            continue;
+        }
+
+        ramOrder.erase(entry.order);
+        ramBytes -= entry.bytes;
+        entry.data.reset();
+        entry.tier = CHUNK_CACHE_DISK;
+        diskOrder.push_front(it->first);
+        entry.order = diskOrder.begin();
+        diskBytes += entry.bytes;
+    }
+
+    // Then forget the oldest files
+    while (diskBytes > diskBudget && !diskOrder.empty()) {
+        Remove(entries.find(diskOrder.back()));
+    }
+}
+
+void ChunkCache::Remove(unordered_map<int64_t, Entry>::iterator it) {
+    Entry& entry = it->second;
+
+    if (entry.tier == CHUNK_CACHE_RAM) {
+        ramOrder.erase(entry.order);
+        ramBytes -= entry.bytes;
+    }
+    else {
+        // Space in the cache file is only given back by the next save
+        diskOrder.erase(entry.order);
+        diskBytes -= entry.bytes;
+        if (entry.fileOffset == NOT_IN_FILE) {
+            remove(GetSpillPath(entry.chunkX, entry.chunkZ).c_str());
+        }
+    }
+
+    entries.erase(it);
+}
+
+uint64_t HashGenerationParameters() {
+    // FNV-1a over the raw bytes of each setting
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const void* value, size_t size) {
+        for (size_t i = 0; i < size; i++) {
+            hash ^= ((const uint8_t*)value)[i];
+            hash *= 1099511628211ull;
+        }
+    };
+
+    add(&CHUNK_SIZE, sizeof(CHUNK_SIZE));
+    add(&TILE_SIZE, sizeof(TILE_SIZE));
+    add(&HEIGHTFIELD_SIZE, sizeof(HEIGHTFIELD_SIZE));
+    add(&CHUNK_CACHE_HEIGHT_STEP, sizeof(CHUNK_CACHE_HEIGHT_STEP));
+    add(&NOISE_BASE_FREQUENCY, sizeof(NOISE_BASE_FREQUENCY));
+    add(&NOISE_BASE_AMPLITUDE, sizeof(NOISE_BASE_AMPLITUDE));
+    add(&NOISE_PERSISTENCE, sizeof(NOISE_PERSISTENCE));
+    add(&NOISE_OCTAVES, sizeof(NOISE_OCTAVES));
+    add(&NOISE_VERSION, sizeof(NOISE_VERSION));
+    return hash;
+}
+
+vector<uint8_t> CompressHeightfield(const ChunkHeightfield& field) {
+    const int size = HEIGHTFIELD_SIZE;
+    vector<uint8_t> data;
+    data.reserve(size * size * 2);
+
+    // Quantize first, so prediction works on exactly the values the decoder will see
+    vector<int32_t> quantized(size * size);
+    for (int i = 0; i < size * size; i++) {
+        quantized[i] = (int32_t)lround(field.heights[i] / CHUNK_CACHE_HEIGHT_STEP);
+    }
+
+    for (int row = 0; row < size; row++) {
+        for (int column = 0; column < size; column++) {
+            const int32_t* sample = &quantized[row * size + column];
+
+            // Terrain is smooth, so the plane through the left, above and above left samples is a close guess
+            int32_t predicted = 0;
+            if (row > 0 && column > 0) {
+                predicted = sample[-1] + sample[-size] - sample[-size - 1];
+            }
+            else if (row > 0) {
+                predicted = sample[-size];
+            }
+            else if (column > 0) {
+                predicted = sample[-1];
+            }
+
+            // Zigzag so small negative differences stay small, then 7 bits per byte
+            int32_t difference = *sample - predicted;
+            uint32_t value = ((uint32_t)difference << 1) ^ (uint32_t)(difference >> 31);
+            while (value >= 0x80) {
+                data.push_back((uint8_t)(value | 0x80));
+                value >>= 7;
+            }
+            data.push_back((uint8_t)value);
+        }
+    }
+
+    return data;
+}
+
+shared_ptr<ChunkHeightfield> DecompressHeightfield(int chunkX, int chunkZ, const uint8_t* data, size_t bytes) {
+    const int size = HEIGHTFIELD_SIZE;
+    vector<int32_t> quantized(size * size);
+    size_t position = 0;
+
+    for (int row = 0; row < size; row++) {
+        for (int column = 0; column < size; column++) {
+            uint32_t value = 0;
+            for (int shift = 0; ; shift += 7) {
+                if (position >= bytes || shift > 28) {
+                    return nullptr;
+                }
+                uint8_t byte = data[position++];
+                value |= (uint32_t)(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                    break;
+                }
+            }
+            int32_t difference = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+
+            int32_t* sample = &quantized[row * size + column];
+            int32_t predicted = 0;
+            if (row > 0 && column > 0) {
+                predicted = sample[-1] + sample[-size] - sample[-size - 1];
+            }
+            else if (row > 0) {
+                predicted = sample[-size];
+            }
+            else if (column > 0) {
+                predicted = sample[-1];
+            }
+            *sample = predicted + difference;
+        }
+    }
+    if (position != bytes) {
+        return nullptr;
+    }
+
+    shared_ptr<ChunkHeightfield> field = make_shared<ChunkHeightfield>();
+    field->chunkX = chunkX;
+    field->chunkZ = chunkZ;
+    field->heights.resize(size * size);
+    for (int i = 0; i < size * size; i++) {
+        field->heights[i] = quantized[i] * CHUNK_CACHE_HEIGHT_STEP;
+    }
+
+    MeasureHeightfield(*field);
+    return field;
+}
+
+shared_ptr<ChunkHeightfield> LoadCachedHeightfield(int chunkX, int chunkZ, const string& path) {
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file) {
+        return nullptr;
+    }
+
+    vector<uint8_t> data((size_t)file.tellg());
+    file.seekg(0);
+    if (!file.read((char*)data.data(), data.size())) {
+        return nullptr;
+    }
+
+    return DecompressHeightfield(chunkX, chunkZ, data.data(), data.size());
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "main.h"
+#include "MappedFile.h"
+
+using namespace std;
+
+
+// Where a chunk was found when it was needed
+enum ChunkCacheTier {
+    CHUNK_CACHE_MISS = 0,       // Generated from noise
+    CHUNK_CACHE_RAM = 1,        // Compressed heightfield in memory
+    CHUNK_CACHE_DISK = 2        // Compressed heightfield in the cache file or spilled to a file of its own
+};
+
+// Cached heightfield handed to a worker thread to rebuild the chunk from
+struct ChunkCacheLookup {
+    ChunkCacheTier tier;
+    const uint8_t* data;            // Compressed heightfield, in memory or straight from the mapped cache file
+    size_t bytes;
+    shared_ptr<const void> owner;   // Keeps data alive until the worker has decompressed it
+    string path;                    // Spill file holding it instead, when data is null
+
+    ChunkCacheLookup() : tier(CHUNK_CACHE_MISS), data(nullptr), bytes(0) {}
+};
+
+// Where chunks came from when they were needed, residentHits are chunks still on the GPU inside the unload hysteresis band
+struct ChunkCacheStats {
+    int residentHits;
+    int ramHits;
+    int diskHits;
+    int misses;
+
+    ChunkCacheStats() : residentHits(0), ramHits(0), diskHits(0), misses(0) {}
+};
+
+
+// Second and third tiers of the chunk cache, below the chunks kept on the GPU. Heightfields of unloaded chunks are
+// kept compressed in memory and the least recently used spill to files once the memory budget is used up. At
+// shutdown everything within the disk budget is saved to one cache file (header, index, compressed heightfields),
+// which the next run maps into memory so workers decompress chunks straight out of it. The file is keyed by the
+// generation parameters, one written with a different CHUNK_SIZE, TILE_SIZE or noise setup is ignored and replaced.
+// Only used from the GL thread, worker threads decompress what Find hands out.
+class ChunkCache {
+public:
+    ChunkCache(size_t ramBudget, size_t diskBudget, const string& directory);
+    ~ChunkCache();
+
+    // Map the cache file saved by an earlier run, if it matches the current generation parameters
+    void Load();
+
+    // Write every cached chunk within the disk budget to the cache file, most recently used first, then map it again.
+    // Call once no worker is reading a lookup any more.
+    bool Save();
+
+    // Keep an unloaded chunk's heightfield, as the most recently used
+    void Store(const ChunkHeightfield& field);
+
+    // Keep a heightfield already compressed with CompressHeightfield, e.g. on a worker thread
+    void Store(int chunkX, int chunkZ, vector<uint8_t> compressed);
+
+    // Look a chunk up, marking it as recently used and counting the hit or miss
+    ChunkCacheLookup Find(int chunkX, int chunkZ);
+
+    // Count a needed chunk that was still loaded
+    void CountResidentHit() { stats.residentHits++; }
+
+    // Delete this session's spill files, unmap the cache file and forget everything, the cache file itself is kept
+    void Clear();
+
+    // Getters and Setters
+    const ChunkCacheStats& GetStats() const { return stats; }
+    void ResetStats() { stats = ChunkCacheStats(); }
+    size_t GetRamBytes() const { return ramBytes; }
+    size_t GetDiskBytes() const { return diskBytes; }
+    int GetFileEntries() const { return fileEntries; }
+
+private:
+    struct Entry {
+        int chunkX;
+        int chunkZ;
+        ChunkCacheTier tier;
+        shared_ptr<const vector<uint8_t>> data;     // Only held in CHUNK_CACHE_RAM
+        size_t fileOffset;                          // Into the mapped cache file, NOT_IN_FILE for spilled entries
+        size_t bytes;
+        list<int64_t>::iterator order;              // Position in the tier's recency list
+    };
+
+    static const size_t NOT_IN_FILE = ~(size_t)0;
+
+    // Built unsigned, shifting a negative chunkX would be undefined
+    static int64_t Key(int chunkX, int chunkZ) { return (int64_t)(((uint64_t)(uint32_t)chunkX << 32) | (uint32_t)chunkZ); }
+    string GetSpillPath(int chunkX, int chunkZ) const;
+    string GetFilePath() const;
+    void EnsureDirectory();
+
+    // Move least recently used entries down a tier until each is within budget
+    void EnforceBudgets();
+    void Remove(unordered_map<int64_t, Entry>::iterator entry);
+
+    size_t ramBudget;
+    size_t diskBudget;
+    string directory;
+    bool directoryCreated;
+
+    shared_ptr<MappedFile> file;                    // Cache file of the last save, null when there is none
+    int fileEntries;                                // Chunks it held when mapped
+
+    unordered_map<int64_t, Entry> entries;
+    list<int64_t> ramOrder;     // Most recently used first
+    list<int64_t> diskOrder;
+    size_t ramBytes;
+    size_t diskBytes;
+    ChunkCacheStats stats;
+};
+
+
+// Function to hash every setting chunk heights depend on, cache files are only used with a matching hash
+uint64_t HashGenerationParameters();
+
+// Function to compress a heightfield for the chunk cache, heights are quantized to CHUNK_CACHE_HEIGHT_STEP and
+// stored as variable length differences from a planar prediction off the samples to the left and above
+vector<uint8_t> CompressHeightfield(const ChunkHeightfield& field);
+
+// Function to rebuild a heightfield (bounds and LOD errors included) from CompressHeightfield data, null if it is corrupt
+shared_ptr<ChunkHeightfield> DecompressHeightfield(int chunkX, int chunkZ, const uint8_t* data, size_t bytes);
+
+// Function to read a heightfield spilled to its own file by the chunk cache, null if the file is missing or corrupt
+shared_ptr<ChunkHeightfield> LoadCachedHeightfield(int chunkX, int chunkZ, const string& path);
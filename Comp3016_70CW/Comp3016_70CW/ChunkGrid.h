@@ -0,0 +1,179 @@
+#pragma once
+#include <cstdlib>
+#include <iterator>
+#include <vector>
+
+using namespace std;
+
+
+// Fixed (2 * radius + 1)^2 window of chunks around a centre chunk, stored toroidally: a chunk lives in the cell at its
+// coordinates modulo the window width, so lookups are O(1), storage is one contiguous array and recentring the window
+// only visits the rows and columns that leave it. Iterates row by row over the window in spatial order.
+template <typename T>
+class ChunkGrid {
+private:
+    struct Cell {
+        int chunkX;
+        int chunkZ;
+        bool occupied;
+        T value;
+
+        Cell() : chunkX(0), chunkZ(0), occupied(false), value() {}
+    };
+
+public:
+    // Forward iterator over occupied cells, in spatial order
+    template <typename GridType, typename ValueType>
+    class Iterator {
+    public:
+        using iterator_category = forward_iterator_tag;
+        using value_type = T;
+        using difference_type = ptrdiff_t;
+        using pointer = ValueType*;
+        using reference = ValueType&;
+
+        Iterator(GridType* grid, int position) : grid(grid), position(position) { SkipEmpty(); }
+
+        reference operator*() const { return grid->CellAt(position).value; }
+        pointer operator->() const { return &grid->CellAt(position).value; }
+        Iterator& operator++() { position++; SkipEmpty(); return *this; }
+        bool operator==(const Iterator& other) const { return position == other.position; }
+        bool operator!=(const Iterator& other) const { return position != other.position; }
+
+    private:
+        void SkipEmpty() {
+            while (position < grid->width * grid->width && !grid->CellAt(position).occupied) {
+                position++;
+            }
+        }
+
+        GridType* grid;
+        int position;           // Window position, row by row from the minimum corner
+    };
+
+    using iterator = Iterator<ChunkGrid, T>;
+    using const_iterator = Iterator<const ChunkGrid, const T>;
+
+    explicit ChunkGrid(int radius) :
+        radius(radius),
+        width(2 * radius + 1),
+        centreX(0),
+        centreZ(0),
+        count(0),
+        cells(width * width)
+    {}
+
+    // Move the window to a new centre. Chunks falling out of it are passed to evict then removed.
+    template <typename Evict>
+    void Recentre(int newCentreX, int newCentreZ, Evict evict) {
+        // Columns leaving the window
+        for (int x = centreX - radius; x <= centreX + radius; x++) {
+            if (abs(x - newCentreX) <= radius) {
+                continue;
+            }
+            for (int z = centreZ - radius; z <= centreZ + radius; z++) {
+                EvictCell(x, z, evict);
+            }
+        }
+
+        // Rows leaving the window, without the columns already done
+        for (int z = centreZ - radius; z <= centreZ + radius; z++) {
+            if (abs(z - newCentreZ) <= radius) {
+                continue;
+            }
+            for (int x = centreX - radius; x <= centreX + radius; x++) {
+                if (abs(x - newCentreX) <= radius) {
+                    EvictCell(x, z, evict);
+                }
+            }
+        }
+
+        centreX = newCentreX;
+        centreZ = newCentreZ;
+    }
+
+    // Whether the chunk is inside the window, only those can be inserted
+    bool InRange(int chunkX, int chunkZ) const {
+        return abs(chunkX - centreX) <= radius && abs(chunkZ - centreZ) <= radius;
+    }
+
+    // Chunk's value, null when it is not held
+    T* Find(int chunkX, int chunkZ) {
+        Cell& cell = cells[Index(chunkX, chunkZ)];
+        return cell.occupied && cell.chunkX == chunkX && cell.chunkZ == chunkZ ? &cell.value : nullptr;
+    }
+    const T* Find(int chunkX, int chunkZ) const {
+        const Cell& cell = cells[Index(chunkX, chunkZ)];
+        return cell.occupied && cell.chunkX == chunkX && cell.chunkZ == chunkZ ? &cell.value : nullptr;
+    }
+
+    // Set a chunk's value, the chunk must be in range
+    T& Insert(int chunkX, int chunkZ, const T& value) {
+        Cell& cell = cells[Index(chunkX, chunkZ)];
+        if (!cell.occupied) {
+            count++;
+        }
+        cell.chunkX = chunkX;
+        cell.chunkZ = chunkZ;
+        cell.occupied = true;
+        cell.value = value;
+        return cell.value;
+    }
+
+    // Remove a chunk if it is held
+    void Erase(int chunkX, int chunkZ) {
+        Cell& cell = cells[Index(chunkX, chunkZ)];
+        if (cell.occupied && cell.chunkX == chunkX && cell.chunkZ == chunkZ) {
+            cell.occupied = false;
+            cell.value = T();
+            count--;
+        }
+    }
+
+    // Iteration
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, width * width); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, width * width); }
+
+    // Getters
+    bool Empty() const { return count == 0; }
+    int Size() const { return count; }
+    int GetCentreX() const { return centreX; }
+    int GetCentreZ() const { return centreZ; }
+
+private:
+    int Wrap(int value) const {
+        return (value % width + width) % width;
+    }
+
+    int Index(int chunkX, int chunkZ) const {
+        return Wrap(chunkZ) * width + Wrap(chunkX);
+    }
+
+    // Cell at a position of the window, counted row by row from its minimum corner
+    Cell& CellAt(int position) {
+        return cells[Index(centreX - radius + position % width, centreZ - radius + position / width)];
+    }
+    const Cell& CellAt(int position) const {
+        return cells[Index(centreX - radius + position % width, centreZ - radius + position / width)];
+    }
+
+    template <typename Evict>
+    void EvictCell(int chunkX, int chunkZ, Evict& evict) {
+        Cell& cell = cells[Index(chunkX, chunkZ)];
+        if (cell.occupied && cell.chunkX == chunkX && cell.chunkZ == chunkZ) {
+            evict(cell.value);
+            cell.occupied = false;
+            cell.value = T();
+            count--;
+        }
+    }
+
+    int radius;
+    int width;
+    int centreX;
+    int centreZ;
+    int count;
+    vector<Cell> cells;         // width * width, indexed by chunk coordinates modulo width
+};
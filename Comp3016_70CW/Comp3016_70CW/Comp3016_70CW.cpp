@@ -1,7 +1,13 @@
 #include <iostream>
 #include <string>
 #include <vector>
-#include <unordered_map>
+#include <deque>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <limits>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #define STB_IMAGE_IMPLEMENTATION
@@ -10,10 +16,21 @@
 #include "glm/glm/ext/vector_float3.hpp"
 #include <glm/glm/ext/matrix_transform.hpp>
 #include <glm/glm/gtc/type_ptr.hpp>
-#include <glm/glm/gtc/noise.hpp>
 
 #include "main.h"
 #include "LoadShaders.h"
+#include "ChunkBuilder.h"
+#include "ChunkCache.h"
+#include "Noise.h"
+#include "Frustum.h"
+#include "Benchmark.h"
+#include "BufferAllocator.h"
+#include "StagingRing.h"
+#include "StagingPool.h"
+#include "ChunkGrid.h"
+#include "ShaderProgram.h"
+#include "GLStateCache.h"
+#include "RenderList.h"
 
 using namespace std;
 using namespace glm;
@@ -25,6 +42,8 @@ public:
         position(vec3((CHUNK_SIZE * TILE_SIZE)/2, 10.0f, (CHUNK_SIZE * TILE_SIZE)/2)),  // Spawn player at centre of starting chunk
         front(vec3(0.0f, 0.0f, -1.0f)),
         up(vec3(0.0f, 1.0f, 0.0f)),
+        velocity(vec3(0.0f)),
+        previousPosition(position),
         yaw(-90.0f),
         pitch(0.0f),
         lastXPos(windowWidth / 2.0f),
@@ -86,14 +105,39 @@ public:
         front = normalize(direction);
     }
 
+    // Place the camera looking along a direction, keeping yaw and pitch in step for mouse look
+    void SetView(const vec3& newPosition, const vec3& direction) {
+        position = newPosition;
+        front = normalize(direction);
+        yaw = degrees(atan2(front.z, front.x));
+        pitch = degrees(asin(front.y));
+    }
+
+    // Estimate velocity from how far the camera moved since the last call, however it was moved
+    void TrackVelocity(float deltaTime) {
+        if (deltaTime > 0.0f) {
+            velocity = (position - previousPosition) / deltaTime;
+        }
+        previousPosition = position;
+    }
+
+    // Forget earlier movement, e.g. after jumping somewhere new
+    void ResetVelocity() {
+        velocity = vec3(0.0f);
+        previousPosition = position;
+    }
+
     // Getters and Setters
     mat4 GetView() { return lookAt(position, position + front, up); }
     vec3 GetPos() { return position; }
+    vec3 GetVelocity() { return velocity; }
 
 private:
     vec3 position;
     vec3 front;
     vec3 up;
+    vec3 velocity;              // World units per second
+    vec3 previousPosition;      // At the last TrackVelocity call
 
     float yaw;
     float pitch;
@@ -107,11 +151,17 @@ class Game {
 public:
     Game() :
         window(nullptr),
-        program(0),
-        waterProgram(0),
+        headless(false),
+        persistentCache(true),
+        gpuCulling(false),
+        offscreenFramebuffer(0),
+        offscreenColour(0),
+        offscreenDepth(0),
+        frameDataBuffer(0),
         windowWidth(1280),
         windowHeight(720),
         deltaTime(0.0f),
+        fixedDeltaTime(0.0f),
         lastFrame(0.0f),
         timeOfDay(0.5f),
         dayLength(120.0f),          // in seconds, 120.0f = 2 minutes
@@ -119,39 +169,103 @@ public:
         lightIntensity(0.0f),
         previousCameraChunk(vec3(0.0f)),
         waterTexture(0),
-        sandTexture(0),
-        grassTexture(0),
-        rockTexture(0),
-        snowTexture(0),
-        sandNormal(0),
-        grassNormal(0),
-        rockNormal(0),
-        snowNormal(0),
+        terrainDiffuse(0),
+        terrainNormals(0),
+        terrainIndexBuffer(0),
+        terrainVertexArray(0),
+        terrainVertexBuffer(0),
+        terrainDrawIndexBuffer(0),
+        terrainCommandBuffer(0),
+        terrainDrawBuffer(0),
+        terrainChunkBuffer(0),
+        terrainPatchBuffer(0),
+        terrainCounterBuffer(0),
+        terrainOrderBuffer(0),
+        terrainChunkDataDirty(false),
+        waterVertexArray(0),
+        waterVertexBuffer(0),
+        waterIndexBuffer(0),
+        waterChunkBuffer(0),
+        waterChunkStride(0),
+        heightmapArray(0),
+        terrainChunks(RESIDENT_DISTANCE),
+        pendingChunks(PREFETCH_WINDOW),
+        chunkCache(CHUNK_CACHE_RAM_BUDGET, CHUNK_CACHE_DISK_BUDGET, CHUNK_CACHE_DIRECTORY),
         projection(mat4(1.0f)),
         camera(windowWidth, windowHeight)
     {}
 
-    void Initialise() {
+    // Create the window, context and every GL resource and load the starting chunks. False when there is no usable context.
+    // Without the persistent cache the chunk cache file is neither read nor written, every chunk starts from noise
+    bool Initialise(bool headlessMode = false, bool persistentCacheMode = true) {
+        headless = headlessMode;
+        persistentCache = persistentCacheMode;
+
+        // Headless runs need no display, prefer GLFW's null platform with an OSMesa (software) context
+        bool nullPlatform = headless && glfwPlatformSupported(GLFW_PLATFORM_NULL);
+        if (nullPlatform) {
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        }
+
         // Initialise GLFW
         glfwInit();
 
         // Create window
+        if (headless) {
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            if (nullPlatform) {
+                glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+                glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+                glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+            }
+        }
         window = glfwCreateWindow(windowWidth, windowHeight, "LOADING...      PLEASE WAIT.", nullptr, nullptr);
+
+        // No OSMesa available, fall back to a hidden window on the native platform
+        if (!window && nullPlatform) {
+            glfwTerminate();
+            glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+            glfwInit();
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            window = glfwCreateWindow(windowWidth, windowHeight, "LOADING...      PLEASE WAIT.", nullptr, nullptr);
+        }
+
         if (!window) {
             cerr << "Failed to initialise GLFW Window" << endl;
             glfwTerminate();
-            return;
+            return false;
         }
         glfwMakeContextCurrent(window);
-        glewInit();
 
-        glEnable(GL_DEPTH_TEST);
+        // GLEW built for GLX loads the GL functions before looking for a GLX display, which an OSMesa context has none of
+        GLenum glewResult = glewInit();
+        if (glewResult != GLEW_OK && !(headless && glewResult == GLEW_ERROR_NO_GLX_DISPLAY)) {
+            cerr << "Failed to initialise GLEW: " << glewGetErrorString(glewResult) << endl;
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            return false;
+        }
+
+        // Culling on the GPU needs the draw count read from a buffer and gl_DrawID, drivers without them cull on the CPU
+        gpuCulling = TERRAIN_GPU_CULLING && GLEW_ARB_indirect_parameters && GLEW_ARB_shader_draw_parameters;
+        if (TERRAIN_GPU_CULLING && !gpuCulling) {
+            cerr << "GL_ARB_indirect_parameters or GL_ARB_shader_draw_parameters is missing, culling terrain on the CPU" << endl;
+        }
+
+        // Headless frames are drawn into a framebuffer of our own, a hidden window's may not exist
+        if (headless) {
+            CreateOffscreenFramebuffer();
+        }
+
+        glState.SetCapability(GL_DEPTH_TEST, true);
         glfwSetFramebufferSizeCallback(window, FramebufferSizeCallback);    // Use the FramebufferSizeCallback function when window is resized
-        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);        // Automatically binds cursor to window & hides pointer
+        if (!headless) {
+            glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);    // Automatically binds cursor to window & hides pointer
+        }
 
         // Enable blending for transparent objects
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glState.SetCapability(GL_BLEND, true);
+        glState.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
         // -=-=- Load shaders -=-=-
         ShaderInfo shaders[] = {
@@ -159,18 +273,56 @@ public:
             { GL_FRAGMENT_SHADER, "shaders/fragmentShader.frag" },
             { GL_NONE, nullptr }
         };
-        program = LoadShaders(shaders);
+        program.Load(shaders);
 
         ShaderInfo waterShaders[] = {
             { GL_VERTEX_SHADER, "shaders/waterVertexShader.vert" },
             { GL_FRAGMENT_SHADER, "shaders/waterFragmentShader.frag" },
             { GL_NONE, nullptr }
         };
-        waterProgram = LoadShaders(waterShaders);
+        waterProgram.Load(waterShaders);
+
+        if (gpuCulling) {
+            ShaderInfo cullShaders[] = {
+                { GL_COMPUTE_SHADER, "shaders/cullTerrain.comp" },
+                { GL_NONE, nullptr }
+            };
+            cullProgram.Load(cullShaders);
+        }
+
+        // Per frame data every program reads, blocks the shaders declare differently from main.h would read garbage
+        glGenBuffers(1, &frameDataBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, frameDataBuffer);
+        glBufferStorage(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_DATA_BINDING, frameDataBuffer);
+
+        if (program.GetUniformBlockSize("FrameData") > (GLint)sizeof(FrameData) ||
+            waterProgram.GetUniformBlockSize("FrameData") > (GLint)sizeof(FrameData) ||
+            waterProgram.GetUniformBlockSize("WaterChunk") > (GLint)sizeof(WaterChunkData)) {
+            cerr << "Shader uniform blocks do not match FrameData and WaterChunkData" << endl;
+        }
 
-        // Set sampler uniform
-        int texLoc = glGetUniformLocation(program, "textureSampler");
-        glUniform1i(texLoc, 0);
+        // Uniforms that stay the same for the whole run are set once. Always give the heightmap its own unit, samplers
+        // of different types may not share one even when unused
+        program.SetUniform("materialDiffuse", 0);
+        program.SetUniform("materialNormal", 1);
+        program.SetUniform("heightmap", 8);
+
+        // Vertex reconstruction parameters, the same for every chunk
+        program.SetUniform("terrainMode", (int)TERRAIN_RENDER_MODE);
+        program.SetUniform("gridSize", CHUNK_SIZE);
+        program.SetUniform("tileSize", TILE_SIZE);
+        program.SetUniform("heightRange", vec2(TERRAIN_MIN_HEIGHT, TERRAIN_MAX_HEIGHT));
+
+        waterProgram.SetUniform("textureIn", 0);
+
+        if (gpuCulling) {
+            cullProgram.SetUniform("viewDistance", VIEW_DISTANCE);
+            cullProgram.SetUniform("pixelError", TERRAIN_LOD_PIXEL_ERROR);
+            cullProgram.SetUniform("tileSize", TILE_SIZE);
+            cullProgram.SetUniform("chunkSlots", MAX_LOADED_CHUNKS);
+            cullProgram.SetUniform("maxDraws", (unsigned int)TERRAIN_MAX_DRAWS);
+        }
 
         SetProjectionMatrix();
 
@@ -178,22 +330,106 @@ public:
         // Load water texture
         waterTexture = LoadTexture("media/water.jpg");
 
-        // Load terrain textures
-        sandTexture = LoadTexture("media/sand.jpg");
-        grassTexture = LoadTexture("media/grass.jpg");
-        rockTexture = LoadTexture("media/rock.jpg");
-        snowTexture = LoadTexture("media/snow.jpg");
+        // Load terrain textures, layers in the order fragmentShader.frag blends them with height
+        terrainDiffuse = LoadTexture({ "media/sand.jpg", "media/grass.jpg", "media/rock.jpg", "media/snow.jpg" });
 
         // Load terrain normals
-        sandNormal = LoadTexture("media/sand_normal.jpg");
-        grassNormal = LoadTexture("media/grass_normal.jpg");
-        rockNormal = LoadTexture("media/rock_normal.jpg");
-        snowNormal = LoadTexture("media/snow_normal.jpg");
+        terrainNormals = LoadTexture({ "media/sand_normal.jpg", "media/grass_normal.jpg", "media/rock_normal.jpg", "media/snow_normal.jpg" });
+
+        // Every chunk has the same vertex grid, so one index buffer serves them all
+        terrainIndexBuffer = CreateTerrainIndexBuffer(CHUNK_SIZE, CHUNK_SIZE, terrainPatches);
+
+        // Chunk meshes share one vertex buffer, each chunk is given a range of it when uploaded
+        // Without gl_DrawID the vertex shader reads each draw's index from an instanced attribute instead
+        if (!GLEW_ARB_shader_draw_parameters) {
+            terrainDrawIndexBuffer = CreateDrawIndexBuffer(TERRAIN_MAX_DRAWS);
+        }
+        terrainVertexArray = CreateTerrainVertexArray(terrainIndexBuffer, terrainVertexBuffer, terrainDrawIndexBuffer, MAX_LOADED_CHUNKS);
+        terrainVertexAllocator.Reset(TERRAIN_RENDER_MODE == TERRAIN_HEIGHTMAP_TEXTURE ? 0 : MAX_LOADED_CHUNKS * TERRAIN_CHUNK_VERTICES);
+
+        // Water quads live in one buffer too, each chunk refills the quad at its slot
+        waterVertexArray = CreateWaterVertexArray(waterVertexBuffer, waterIndexBuffer, MAX_LOADED_CHUNKS);
+
+        // Along with their WaterChunkData, bound as a range per draw so ranges start on the offset alignment
+        GLint uniformAlignment = 1;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+        waterChunkStride = ((GLintptr)sizeof(WaterChunkData) + uniformAlignment - 1) / uniformAlignment * uniformAlignment;
+
+        glGenBuffers(1, &waterChunkBuffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, waterChunkBuffer);
+        glBufferStorage(GL_UNIFORM_BUFFER, MAX_LOADED_CHUNKS * waterChunkStride, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        // Chunk data is written into persistently mapped memory and copied to its destination on the GPU. Workers build
+        // meshes straight into pool slots handed out in advance, heightfields are written into a ring when uploaded.
+        if (TERRAIN_RENDER_MODE == TERRAIN_HEIGHTMAP_TEXTURE) {
+            stagingRing.Create(STAGING_RING_SIZE);
+        }
+        else {
+            meshStaging.Create((GLsizeiptr)TERRAIN_CHUNK_VERTICES * TERRAIN_VERTEX_SIZE, MESH_STAGING_SLOTS);
+            for (int slot = 0; slot < meshStaging.GetSlotCount(); slot++) {
+                ProvideMeshSpace(slot);
+            }
+        }
+
+        // Heightmap mode draws the same grid for every chunk, reading heights from a texture array layer
+        if (TERRAIN_RENDER_MODE == TERRAIN_HEIGHTMAP_TEXTURE) {
+            heightmapArray = CreateHeightmapArray(HEIGHTMAP_LAYERS);
+        }
+        for (int slot = MAX_LOADED_CHUNKS - 1; slot >= 0; slot--) {
+            freeChunkSlots.push_back(slot);
+        }
+
+        // Indirect draw commands and the per draw data they index, rewritten every frame
+        glGenBuffers(1, &terrainCommandBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, terrainCommandBuffer);
+        glBufferStorage(GL_DRAW_INDIRECT_BUFFER, TERRAIN_MAX_DRAWS * sizeof(DrawElementsIndirectCommand), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        glGenBuffers(1, &terrainDrawBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, terrainDrawBuffer);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, TERRAIN_MAX_DRAWS * sizeof(TerrainDrawData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, terrainDrawBuffer);
+
+        // Inputs and counters of the culling pass, which writes the two buffers above
+        if (gpuCulling) {
+            glGenBuffers(1, &terrainChunkBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, terrainChunkBuffer);
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, MAX_LOADED_CHUNKS * sizeof(TerrainChunkData), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, terrainChunkBuffer);
+
+            glGenBuffers(1, &terrainPatchBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, terrainPatchBuffer);
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, terrainPatches.size() * sizeof(TerrainPatch), terrainPatches.data(), 0);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, terrainPatchBuffer);
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, terrainCommandBuffer);
+
+            glGenBuffers(1, &terrainCounterBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, terrainCounterBuffer);
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, 4 * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, terrainCounterBuffer);
+
+            glGenBuffers(1, &terrainOrderBuffer);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, terrainOrderBuffer);
+            glBufferStorage(GL_SHADER_STORAGE_BUFFER, MAX_LOADED_CHUNKS * sizeof(GLint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, terrainOrderBuffer);
+        }
 
+        // Creating the resources above bound textures and vertex arrays directly
+        glState.Invalidate();
+
+        // Chunks cached by earlier runs are decompressed instead of generated
+        if (persistentCache) {
+            chunkCache.Load();
+        }
+
+        // Start chunk generation threads and wait for the starting chunks before showing the world
+        chunkBuilder.Start();
         UpdateTerrainChunks();
+        WaitForPendingChunks();
 
         // Remove loading title
         glfwSetWindowTitle(window, "window");
+        return true;
     }
 
     void HandleInput() {
@@ -212,8 +448,9 @@ public:
     void Update() {
         // Calculate delta time
         float currentFrame = (float)glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
+        deltaTime = fixedDeltaTime > 0.0f ? fixedDeltaTime : currentFrame - lastFrame;
         lastFrame = currentFrame;
+        camera.TrackVelocity(deltaTime);
 
         // Advance day/night cycle
         timeOfDay += deltaTime / dayLength;
@@ -268,11 +505,29 @@ public:
 
         // Update chunks when camera enters a new chunk
         if (currentCameraChunk != previousCameraChunk) {
-            cout << "Updating chunks..." << endl;
+            if (!headless) {
+                cout << "Updating chunks..." << endl;
+            }
             UpdateTerrainChunks();
 
             previousCameraChunk = currentCameraChunk;
         }
+
+        // Generate the chunks the camera is heading towards before it gets there
+        PrefetchChunks();
+
+        // Upload chunks finished by the worker threads
+        UploadBuiltChunks(MAX_CHUNK_UPLOADS_PER_FRAME);
+
+        // LOD levels are picked by the culling pass when it runs on the GPU, which only needs to hear about loads and unloads
+        if (gpuCulling) {
+            if (terrainChunkDataDirty) {
+                WriteTerrainChunkData();
+            }
+        }
+        else {
+            SelectTerrainLods();
+        }
     }
 
     void Render() {
@@ -282,90 +537,299 @@ public:
         // Camera view matrix sets position of the viewer, movement direction in relation to it & world up direction
         mat4 view = camera.GetView();
 
+        mat4 viewProjection = projection * view;
+
+        // Per frame data for every program, written once
+        FrameData frameData = {};
+        frameData.view = view;
+        frameData.projection = projection;
+        frameData.viewProjection = viewProjection;
+        frameData.lightIntensity = lightIntensity;
+        frameData.timer = (float)glfwGetTime();
+
+        glBindBuffer(GL_UNIFORM_BUFFER, frameDataBuffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frameData), &frameData);
+
         // -=-=- Render Terrain -=-=-
-        glUseProgram(program);
+        // Skip chunks and sub-patches outside the view, building one indirect draw per visible sub-patch range
+        Frustum frustum = ExtractFrustum(viewProjection);
+        cullingStats = CullingStats();
+        BuildRenderList(frustum);
+        if (gpuCulling) {
+            CullTerrainChunksGpu(frustum);
+        }
+        else {
+            CullTerrainChunks(frustum);
 
-        // Render each chunk
-        for (auto& pair : terrainChunks) {
-            RenderTerrainObject& chunkTerrain = pair.second.terrain;
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, terrainCommandBuffer);
+            glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, terrainCommands.size() * sizeof(DrawElementsIndirectCommand), terrainCommands.data());
 
-            // Bind Textures
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, chunkTerrain.sandTexture);
-            glUniform1i(glGetUniformLocation(program, "sandDiffuse"), 0);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, terrainDrawBuffer);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, terrainDrawData.size() * sizeof(TerrainDrawData), terrainDrawData.data());
+        }
 
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, chunkTerrain.grassTexture);
-            glUniform1i(glGetUniformLocation(program, "grassDiffuse"), 1);
+        // Render all visible terrain in one call, each draw reads its chunk's data through gl_DrawID
+        if (!terrainChunks.Empty()) {
+            glState.UseProgram(program.GetId());
 
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, chunkTerrain.rockTexture);
-            glUniform1i(glGetUniformLocation(program, "rockDiffuse"), 2);
+            // Textures are shared by every chunk, bound once per frame
+            BindTerrainTextures();
 
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D, chunkTerrain.snowTexture);
-            glUniform1i(glGetUniformLocation(program, "snowDiffuse"), 3);
+            glState.BindVertexArray(terrainVertexArray);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, terrainCommandBuffer);
+            if (gpuCulling) {
+                // The number of draws never comes back to the CPU
+                glBindBuffer(GL_PARAMETER_BUFFER_ARB, terrainCounterBuffer);
+                glMultiDrawElementsIndirectCountARB(GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr, 0, TERRAIN_MAX_DRAWS, 0);
+            }
+            else if (!terrainCommands.empty()) {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr, (GLsizei)terrainCommands.size(), 0);
+            }
+        }
 
-            // Bind Normals
-            glActiveTexture(GL_TEXTURE4);
-            glBindTexture(GL_TEXTURE_2D, chunkTerrain.sandNormal);
-            glUniform1i(glGetUniformLocation(program, "sandNormal"), 4);
+        // -=-=- Render Water -=-=-
+        glState.UseProgram(waterProgram.GetId());
+        glState.DepthMask(false);
 
-            glActiveTexture(GL_TEXTURE5);
-            glBindTexture(GL_TEXTURE_2D, chunkTerrain.grassNormal);
-            glUniform1i(glGetUniformLocation(program, "grassNormal"), 5);
+        // Render each visible chunk, furthest first
+        for (int record : renderList.waterOrder) {
+            // Bind Texture
+            glState.BindTexture(GL_TEXTURE0, GL_TEXTURE_2D, renderList.waterTexture[record]);
 
-            glActiveTexture(GL_TEXTURE6);
-            glBindTexture(GL_TEXTURE_2D, chunkTerrain.rockNormal);
-            glUniform1i(glGetUniformLocation(program, "rockNormal"), 6);
+            // Model matrix and alpha come from the chunk's range of the water chunk buffer
+            glBindBufferRange(GL_UNIFORM_BUFFER, WATER_CHUNK_BINDING, waterChunkBuffer, renderList.waterDataOffset[record], sizeof(WaterChunkData));
 
-            glActiveTexture(GL_TEXTURE7);
-            glBindTexture(GL_TEXTURE_2D, chunkTerrain.snowNormal);
-            glUniform1i(glGetUniformLocation(program, "snowNormal"), 7);
+            glState.BindVertexArray(renderList.waterVertexArray[record]);
+            glDrawElementsBaseVertex(GL_TRIANGLES, renderList.waterIndexCount[record], GL_UNSIGNED_INT, nullptr, renderList.waterBaseVertex[record]);
+        }
+        glState.DepthMask(true);
 
-            // Pass light intensity to shader
-            glUniform1f(glGetUniformLocation(program, "lightIntensity"), lightIntensity);
+        // Refreshing
+        glfwSwapBuffers(window);    // Swaps the colour buffer
+        glfwPollEvents();           // Queries all GLFW events
+    }
 
-            // Build transform
-            mat4 terrainMvp = projection * view * chunkTerrain.modelMatrix;
-            glUniformMatrix4fv(glGetUniformLocation(program, "mvpIn"), 1, GL_FALSE, value_ptr(terrainMvp));
-            glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, value_ptr(chunkTerrain.modelMatrix));
+    // Test every chunk in render distance against the view frustum, terrain and water boxes each in one batch, and list
+    // the visible ones sorted for drawing. With GPU culling the terrain test is left to the culling pass
+    void BuildRenderList(const Frustum& frustum) {
+        renderList.Clear();
+
+        // Gather bounds, terrain boxes reach down to the bottom of the skirts
+        vector<TerrainChunk*> chunks;
+        chunkBoxes.Clear();
+        waterBoxes.Clear();
+        for (TerrainChunk& chunk : terrainChunks) {
+            if (!InRenderDistance(chunk.chunkX, chunk.chunkZ)) {
+                continue;
+            }
+            chunks.push_back(&chunk);
+
+            vec3 origin = vec3(chunk.chunkX * CHUNK_WORLD_SIZE, 0.0f, chunk.chunkZ * CHUNK_WORLD_SIZE);
+            chunkBoxes.Add(
+                vec3(origin.x, chunk.heightfield->minHeight - chunk.terrain.skirtDepth, origin.z),
+                vec3(origin.x + CHUNK_WORLD_SIZE, chunk.heightfield->maxHeight, origin.z + CHUNK_WORLD_SIZE)
+            );
+            waterBoxes.Add(
+                vec3(origin.x, WATER_LEVEL, origin.z),
+                vec3(origin.x + CHUNK_WORLD_SIZE, WATER_LEVEL, origin.z + CHUNK_WORLD_SIZE)
+            );
+        }
 
-            glBindVertexArray(chunkTerrain.VAO);
-            glDrawElements(GL_TRIANGLES, chunkTerrain.indexCount, GL_UNSIGNED_INT, nullptr);
+        vector<FrustumTest> chunkResults(chunks.size(), FRUSTUM_INTERSECTS);
+        if (!gpuCulling) {
+            TestBoxes(frustum, chunkBoxes, chunkResults.data());
         }
+        vector<FrustumTest> waterResults(chunks.size());
+        TestBoxes(frustum, waterBoxes, waterResults.data());
 
-        // -=-=- Render Water -=-=-
-        float waterTimer = (float)glfwGetTime();
-        glUseProgram(waterProgram);
-        glDepthMask(GL_FALSE);
+        vec3 cameraPos = camera.GetPos();
+        for (size_t i = 0; i < chunks.size(); i++) {
+            if (chunkResults[i] == FRUSTUM_OUTSIDE) {
+                cullingStats.terrainChunksCulled++;
+            }
+            if (waterResults[i] == FRUSTUM_OUTSIDE) {
+                cullingStats.waterChunksCulled++;
+            }
+            else {
+                cullingStats.waterChunksDrawn++;
+            }
+            if (chunkResults[i] == FRUSTUM_OUTSIDE && waterResults[i] == FRUSTUM_OUTSIDE) {
+                continue;
+            }
 
-        // Render each chunk
-        for (auto& pair : terrainChunks) {
-            RenderWaterObject& chunkWater = pair.second.water;
+            renderList.Add(
+                *chunks[i],
+                SquaredBoxDistance(cameraPos, chunkBoxes, (int)i), SquaredBoxDistance(cameraPos, waterBoxes, (int)i),
+                chunkResults[i], waterResults[i]
+            );
+        }
 
-            // Bind Texture
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, chunkWater.texture);
-            glUniform1i(glGetUniformLocation(waterProgram, "diffuseMap"), 0);
+        renderList.Sort();
+    }
+
+    // Squared distance from a point to the closest point of a box in a list
+    float SquaredBoxDistance(const vec3& point, const BoxList& boxes, int box) {
+        vec3 closest = clamp(
+            point,
+            vec3(boxes.minX[box], boxes.minY[box], boxes.minZ[box]),
+            vec3(boxes.maxX[box], boxes.maxY[box], boxes.maxZ[box])
+        );
+        vec3 offset = point - closest;
+        return dot(offset, offset);
+    }
 
-            // Pass needed variables to shader
-            glUniform1f(glGetUniformLocation(waterProgram, "lightIntensity"), lightIntensity);
-            glUniform1f(glGetUniformLocation(waterProgram, "timer"), waterTimer);
-            glUniform1f(glGetUniformLocation(waterProgram, "waterAlpha"), chunkWater.alpha);
+    // Build the indirect draws of the listed chunks' visible sub-patches, nearest chunk first
+    void CullTerrainChunks(const Frustum& frustum) {
+        visibleTerrain.clear();
+        terrainCommands.clear();
+        terrainDrawData.clear();
 
-            // Build transform
-            mat4 waterMvp = projection * view * chunkWater.modelMatrix;
-            glUniformMatrix4fv(glGetUniformLocation(waterProgram, "mvpIn"), 1, GL_FALSE, value_ptr(waterMvp));
+        for (int record : renderList.terrainOrder) {
+            VisibleTerrainChunk visible;
+            visible.record = record;
+            visible.firstRange = (int)terrainCommands.size();
+            visible.whole = renderList.terrainTest[record] == FRUSTUM_INSIDE;
 
-            glBindVertexArray(chunkWater.VAO);
-            glDrawElements(GL_TRIANGLES, chunkWater.indexCount, GL_UNSIGNED_INT, nullptr);
+            if (visible.whole) {
+                AddVisibleRange(record, visible.firstRange, terrainPatches[renderList.terrainLod[record] * TERRAIN_PATCH_NODES]);
+            }
+            else {
+                CullTerrainPatches(frustum, record, 0, visible.firstRange);
+            }
+
+            // Every sub-patch can still be outside when only the chunk's corner clips the frustum
+            visible.rangeCount = (int)terrainCommands.size() - visible.firstRange;
+            if (visible.rangeCount > 0) {
+                visibleTerrain.push_back(visible);
+                cullingStats.terrainChunksDrawn++;
+            }
+            else {
+                cullingStats.terrainChunksCulled++;
+            }
         }
-        glDepthMask(GL_TRUE);
+    }
 
-        // Refreshing
-        glfwSwapBuffers(window);    // Swaps the colour buffer
-        glfwPollEvents();           // Queries all GLFW events
+    // Test the four children of a partly visible sub-patch of a render list record, adding visible ranges and recursing
+    // into partly visible children
+    void CullTerrainPatches(const Frustum& frustum, int record, int node, int firstRange) {
+        int level = renderList.terrainLod[record];
+        const TerrainPatch* patches = &terrainPatches[level * TERRAIN_PATCH_NODES];
+        const ChunkHeightfield& heights = *renderList.terrainHeights[record];
+        vec2 origin = renderList.terrainOrigin[record];
+        float skirtDepth = renderList.terrainSkirtDepth[record];
+
+        // All four children in one batch
+        BoxList childBoxes;
+        for (int child = 4 * node + 1; child <= 4 * node + 4; child++) {
+            const TerrainPatch& patch = patches[child];
+            childBoxes.Add(
+                vec3(origin.x + patch.x0 * TILE_SIZE, heights.patchMinHeight[level][child] - skirtDepth, origin.y + patch.z0 * TILE_SIZE),
+                vec3(origin.x + patch.x1 * TILE_SIZE, heights.patchMaxHeight[level][child], origin.y + patch.z1 * TILE_SIZE)
+            );
+        }
+
+        FrustumTest results[4];
+        TestBoxes(frustum, childBoxes, results);
+
+        for (int i = 0; i < 4; i++) {
+            int child = 4 * node + 1 + i;
+            const TerrainPatch& patch = patches[child];
+            if (patch.indexCount == 0) {
+                continue;
+            }
+
+            bool leaf = 4 * child + 1 >= TERRAIN_PATCH_NODES;
+            if (results[i] == FRUSTUM_OUTSIDE) {
+                cullingStats.terrainPatchesCulled++;
+            }
+            else if (results[i] == FRUSTUM_INSIDE || leaf) {
+                AddVisibleRange(record, firstRange, patch);
+            }
+            else {
+                CullTerrainPatches(frustum, record, child, firstRange);
+            }
+        }
+    }
+
+    // Add a draw of a sub-patch's index range for a render list record, merging it into the previous draw when they touch
+    void AddVisibleRange(int record, int firstRange, const TerrainPatch& patch) {
+        if ((int)terrainCommands.size() > firstRange) {
+            DrawElementsIndirectCommand& last = terrainCommands.back();
+            if (last.firstIndex + last.count == patch.firstIndex) {
+                last.count += patch.indexCount;
+                return;
+            }
+        }
+
+        DrawElementsIndirectCommand command;
+        command.count = patch.indexCount;
+        command.instanceCount = 1;
+        command.firstIndex = patch.firstIndex;
+        command.baseVertex = renderList.terrainBaseVertex[record];
+        command.baseInstance = (GLuint)terrainCommands.size();     // Draw index, for drivers without gl_DrawID
+        terrainCommands.push_back(command);
+
+        vec2 origin = renderList.terrainOrigin[record];
+        TerrainDrawData data;
+        data.model = renderList.terrainModel[record];
+        data.chunk = vec4(origin.x, origin.y, renderList.terrainSkirtDepth[record], (float)renderList.terrainHeightmapLayer[record]);
+        terrainDrawData.push_back(data);
+    }
+
+    // Cull terrain on the GPU, the culling pass writes the indirect draws, their draw data and the draw count
+    void CullTerrainChunksGpu(const Frustum& frustum) {
+        // Start the draw count and statistics from zero
+        const GLuint zero[4] = {};
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, terrainCounterBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), zero);
+
+        // Invocations take chunks nearest first, so draws are appended roughly front to back. Unused entries are -1
+        vector<GLint> order(MAX_LOADED_CHUNKS, -1);
+        for (size_t i = 0; i < renderList.terrainOrder.size(); i++) {
+            order[i] = renderList.slot[renderList.terrainOrder[i]];
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, terrainOrderBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, order.size() * sizeof(GLint), order.data());
+
+        // The rest of its uniforms are set once at startup
+        glState.UseProgram(cullProgram.GetId());
+        cullProgram.SetUniform("frustumPlanes", frustum.planes, 6);
+        cullProgram.SetUniform("cameraPosition", camera.GetPos());
+        cullProgram.SetUniform("pixelScale", GetLodPixelScale());
+        glDispatchCompute((MAX_LOADED_CHUNKS + TERRAIN_CULL_GROUP_SIZE - 1) / TERRAIN_CULL_GROUP_SIZE, 1, 1);
+
+        // Draws read the results as indirect commands, draw count and vertex shader storage
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    // Queue a copy of the counters written by the GPU culling pass into a readback buffer, without waiting for the GPU
+    void CopyGpuCullingCounters(GLuint readbackBuffer) {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_COPY_READ_BUFFER, terrainCounterBuffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, readbackBuffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, 4 * sizeof(GLuint));
+    }
+
+    // Copy the terrain culling statistics from a readback buffer filled by CopyGpuCullingCounters, waits for the copy
+    void ReadGpuCullingStats(GLuint readbackBuffer, BenchmarkFrame& result) {
+        GLuint counters[4];
+        glBindBuffer(GL_COPY_READ_BUFFER, readbackBuffer);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(counters), counters);
+
+        result.terrainChunksDrawn = (int)counters[1];
+        result.terrainChunksCulled = (int)counters[2];
+        result.terrainPatchesCulled = (int)counters[3];
+    }
+
+    void BindTerrainTextures() {
+        // Bind Textures, one material per layer
+        glState.BindTexture(GL_TEXTURE0, GL_TEXTURE_2D_ARRAY, terrainDiffuse);
+
+        // Bind Normals
+        glState.BindTexture(GL_TEXTURE1, GL_TEXTURE_2D_ARRAY, terrainNormals);
+
+        // Bind Heightmaps
+        glState.BindTexture(GL_TEXTURE8, GL_TEXTURE_2D_ARRAY, heightmapArray);
     }
 
     void Run() {
@@ -376,91 +840,544 @@ public:
         }
     }
 
+    // Fly the benchmark camera path for a fixed number of frames, then write the timings out as JSON
+    bool RunBenchmark(const BenchmarkSettings& settings) {
+        CameraPath path;
+        vector<BenchmarkFrame> frames(settings.frames);
+        fixedDeltaTime = BENCHMARK_FRAME_TIME;
+
+        // Start on the path with the surrounding chunks loaded
+        float travelled = 0.0f;
+        camera.SetView(path.GetPosition(travelled), path.GetDirection(travelled));
+        camera.ResetVelocity();
+        ChunkKey startChunk = GetCameraChunk();
+        previousCameraChunk = vec3((float)startChunk.x, 0.0f, (float)startChunk.z);
+        UpdateTerrainChunks();
+        WaitForPendingChunks();
+
+        // One unmeasured frame, so first use costs (shader compilation, driver setup) stay out of the results
+        Update();
+        Render();
+        glFinish();
+        chunkLatencies.clear();
+        prefetchStats = PrefetchStats();
+        chunkCache.ResetStats();
+        glState.ResetStats();
+
+        // GPU time and the GPU culling counters are read a few frames late so waiting on them does not stall the pipeline
+        GLuint queries[BENCHMARK_QUERY_FRAMES];
+        glGenQueries(BENCHMARK_QUERY_FRAMES, queries);
+        GLuint counterReadback[BENCHMARK_QUERY_FRAMES];
+        glGenBuffers(BENCHMARK_QUERY_FRAMES, counterReadback);
+        for (GLuint buffer : counterReadback) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferStorage(GL_COPY_WRITE_BUFFER, 4 * sizeof(GLuint), nullptr, 0);
+        }
+        auto readGpuResults = [&](int frame) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[frame % BENCHMARK_QUERY_FRAMES], GL_QUERY_RESULT, &elapsed);
+            frames[frame].gpuMs = elapsed / 1.0e6;
+            if (gpuCulling) {
+                ReadGpuCullingStats(counterReadback[frame % BENCHMARK_QUERY_FRAMES], frames[frame]);
+            }
+        };
+
+        for (int frame = 0; frame < settings.frames; frame++) {
+            if (frame >= BENCHMARK_QUERY_FRAMES) {
+                readGpuResults(frame - BENCHMARK_QUERY_FRAMES);
+            }
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            glBeginQuery(GL_TIME_ELAPSED, queries[frame % BENCHMARK_QUERY_FRAMES]);
+
+            camera.SetView(path.GetPosition(travelled), path.GetDirection(travelled));
+            travelled += BENCHMARK_CAMERA_SPEED * BENCHMARK_FRAME_TIME;
+            Update();
+            Render();
+
+            glEndQuery(GL_TIME_ELAPSED);
+            BenchmarkFrame& result = frames[frame];
+            result.cpuMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+            // Terrain counts of the GPU culling pass are only known on the GPU, read with the frame's GPU time
+            if (gpuCulling) {
+                CopyGpuCullingCounters(counterReadback[frame % BENCHMARK_QUERY_FRAMES]);
+            }
+            else {
+                result.terrainChunksDrawn = cullingStats.terrainChunksDrawn;
+                result.terrainChunksCulled = cullingStats.terrainChunksCulled;
+                result.terrainPatchesCulled = cullingStats.terrainPatchesCulled;
+            }
+
+            result.chunkLatencyMs.swap(chunkLatencies);
+            chunkLatencies.clear();
+            result.waterChunksDrawn = cullingStats.waterChunksDrawn;
+            result.waterChunksCulled = cullingStats.waterChunksCulled;
+            result.glState = glState.GetStats();
+            glState.ResetStats();
+        }
+
+        for (int frame = std::max(0, settings.frames - BENCHMARK_QUERY_FRAMES); frame < settings.frames; frame++) {
+            readGpuResults(frame);
+        }
+        glDeleteQueries(BENCHMARK_QUERY_FRAMES, queries);
+        glDeleteBuffers(BENCHMARK_QUERY_FRAMES, counterReadback);
+        fixedDeltaTime = 0.0f;
+
+        return WriteBenchmarkJson(settings.outputPath, frames, windowWidth, windowHeight, chunkBuilder.GetThreadCount(), prefetchStats, chunkCache, settings.persistentCache);
+    }
+
     void CleanUp() {
+        chunkBuilder.Stop();
+
+        // Cache the loaded chunks too, so the next run starts from the cache file
+        if (persistentCache) {
+            for (const TerrainChunk& chunk : terrainChunks) {
+                chunkCache.Store(*chunk.heightfield);
+            }
+            chunkCache.Save();
+        }
+        chunkCache.Clear();
+
+        glDeleteBuffers(1, &terrainIndexBuffer);
+        glDeleteVertexArrays(1, &terrainVertexArray);
+        glDeleteBuffers(1, &terrainVertexBuffer);
+        glDeleteBuffers(1, &terrainDrawIndexBuffer);
+        glDeleteBuffers(1, &terrainCommandBuffer);
+        glDeleteBuffers(1, &terrainDrawBuffer);
+        glDeleteBuffers(1, &terrainChunkBuffer);
+        glDeleteBuffers(1, &terrainPatchBuffer);
+        glDeleteBuffers(1, &terrainCounterBuffer);
+        glDeleteBuffers(1, &terrainOrderBuffer);
+        glDeleteVertexArrays(1, &waterVertexArray);
+        glDeleteBuffers(1, &waterVertexBuffer);
+        glDeleteBuffers(1, &waterIndexBuffer);
+        glDeleteBuffers(1, &waterChunkBuffer);
+        glDeleteBuffers(1, &frameDataBuffer);
+        program.Destroy();
+        waterProgram.Destroy();
+        cullProgram.Destroy();
+        stagingRing.Destroy();
+        meshStaging.Destroy();
+        glDeleteTextures(1, &heightmapArray);
+        glDeleteFramebuffers(1, &offscreenFramebuffer);
+        glDeleteRenderbuffers(1, &offscreenColour);
+        glDeleteRenderbuffers(1, &offscreenDepth);
         glfwTerminate();
     }
 
     void UpdateTerrainChunks() {
         // Find which chunk the camera is in
-        vec3 cameraPosition = camera.GetPos();
-        int cameraChunkX = (int)floor(cameraPosition.x / CHUNK_WORLD_SIZE);
-        int cameraChunkZ = (int)floor(cameraPosition.z / CHUNK_WORLD_SIZE);
+        ChunkKey cameraChunk = GetCameraChunk();
+        int cameraChunkX = cameraChunk.x;
+        int cameraChunkZ = cameraChunk.z;
+        int previousChunkX = terrainChunks.GetCentreX();
+        int previousChunkZ = terrainChunks.GetCentreZ();
+
+        // Generate chunks nearest to the camera first
+        chunkBuilder.SetFocus(cameraChunkX, cameraChunkZ);
+
+        // Drop queued requests that are no longer needed
+        chunkBuilder.CancelOutside(cameraChunkX, cameraChunkZ, PREFETCH_WINDOW);
+        pendingChunks.Recentre(cameraChunkX, cameraChunkZ, [this](PendingChunk& pending) {
+            if (pending.prefetched) {
+                prefetchStats.wasted++;
+            }
+        });
+
+        // Unload chunks past the hysteresis band, only the rows and columns leaving it are visited
+        terrainChunks.Recentre(cameraChunkX, cameraChunkZ, [this](TerrainChunk& chunk) {
+            // Release the chunk's slot (and with it the water quad) and share of the terrain vertex buffer
+            freeChunkSlots.push_back(chunk.slot);
+            if (TERRAIN_RENDER_MODE != TERRAIN_HEIGHTMAP_TEXTURE) {
+                terrainVertexAllocator.Free(chunk.terrain.baseVertex);
+            }
+            if (chunk.prefetched) {
+                prefetchStats.wasted++;
+            }
 
-        // Load nearby chunks
+            // Keep its heights, so coming back decompresses the chunk instead of generating it again
+            chunkCache.Store(*chunk.heightfield);
+        });
+
+        // Chunks inside the band but outside render distance stay loaded, only their culling entries change
+        terrainChunkDataDirty = true;
+
+        // Request nearby chunks
         for (int z = -RENDER_DISTANCE; z <= RENDER_DISTANCE; z++) {
             for (int x = -RENDER_DISTANCE; x <= RENDER_DISTANCE; x++) {
                 int currentChunkX = cameraChunkX + x;
                 int currentChunkZ = cameraChunkZ + z;
 
-                // Create unique key for current chunk
-                ChunkKey key{ currentChunkX, currentChunkZ };
-
-                // If chunk did not already exist, create it
-                if (terrainChunks.find(key) == terrainChunks.end()) {
-                    TerrainChunk chunk;
-                    chunk.chunkX = currentChunkX;
-                    chunk.chunkZ = currentChunkZ;
-
-                    chunk.terrain = CreateTerrain(
-                        CHUNK_SIZE, CHUNK_SIZE, TILE_SIZE, currentChunkX, currentChunkZ,
-                        sandTexture, sandNormal,
-                        grassTexture, grassNormal,
-                        rockTexture, rockNormal,
-                        snowTexture, snowNormal
-                    );
-
-                    chunk.water = CreateWater(
-                        CHUNK_SIZE, CHUNK_SIZE, TILE_SIZE, currentChunkX, currentChunkZ, 0.5f, waterTexture
-                    );
-
-                    // Add current chunk to chunk map
-                    terrainChunks[key] = chunk;
+                // Chunks still loaded from before, or loaded ahead of the camera
+                TerrainChunk* loaded = terrainChunks.Find(currentChunkX, currentChunkZ);
+                if (loaded) {
+                    if (loaded->prefetched) {
+                        loaded->prefetched = false;
+                        prefetchStats.hits++;
+                        chunkLatencies.push_back(0.0);
+                    }
+                    else if (abs(currentChunkX - previousChunkX) > RENDER_DISTANCE || abs(currentChunkZ - previousChunkZ) > RENDER_DISTANCE) {
+                        chunkCache.CountResidentHit();
+                    }
+                    continue;
+                }
+
+                // Ones still being built are timed from now, when they are needed
+                PendingChunk* pending = pendingChunks.Find(currentChunkX, currentChunkZ);
+                if (pending) {
+                    if (pending->prefetched) {
+                        *pending = PendingChunk(chrono::steady_clock::now(), false);
+                        prefetchStats.hits++;
+                    }
+                    continue;
+                }
+
+                // Otherwise queue it for the worker threads
+                RequestChunk(currentChunkX, currentChunkZ, false);
+                prefetchStats.misses++;
+            }
+        }
+    }
+
+    // Request the chunks the camera's velocity would bring into render distance within PREFETCH_LOOKAHEAD seconds
+    void PrefetchChunks() {
+        ChunkKey cameraChunk = GetCameraChunk();
+        vec3 predicted = camera.GetPos() + camera.GetVelocity() * PREFETCH_LOOKAHEAD;
+
+        // Chunk the camera is predicted to be in, no further than the prefetch window allows
+        int predictedX = clamp((int)floor(predicted.x / CHUNK_WORLD_SIZE), cameraChunk.x - PREFETCH_DISTANCE, cameraChunk.x + PREFETCH_DISTANCE);
+        int predictedZ = clamp((int)floor(predicted.z / CHUNK_WORLD_SIZE), cameraChunk.z - PREFETCH_DISTANCE, cameraChunk.z + PREFETCH_DISTANCE);
+        if (predictedX == cameraChunk.x && predictedZ == cameraChunk.z) {
+            return;
+        }
+
+        // Chunks that would be within render distance there but are not yet, and are not still loaded
+        for (int z = predictedZ - RENDER_DISTANCE; z <= predictedZ + RENDER_DISTANCE; z++) {
+            for (int x = predictedX - RENDER_DISTANCE; x <= predictedX + RENDER_DISTANCE; x++) {
+                if (InRenderDistance(x, z) || !pendingChunks.InRange(x, z) || terrainChunks.Find(x, z)) {
+                    continue;
+                }
+                if (!pendingChunks.Find(x, z)) {
+                    RequestChunk(x, z, true);
+                }
+            }
+        }
+    }
+
+    // Queue a chunk for the worker threads, which rebuild it from the chunk cache when it was loaded before
+    void RequestChunk(int chunkX, int chunkZ, bool prefetched) {
+        chunkBuilder.Request(chunkX, chunkZ, GetLoadedNeighbours(chunkX, chunkZ), chunkCache.Find(chunkX, chunkZ));
+        pendingChunks.Insert(chunkX, chunkZ, PendingChunk(chrono::steady_clock::now(), prefetched));
+    }
+
+    // Upload meshes finished by the worker threads, at most maxUploads per call (negative = no limit)
+    void UploadBuiltChunks(int maxUploads) {
+        // Hand mesh staging slots the GPU has finished copying from back to the workers
+        for (int slot : meshStaging.Reclaim()) {
+            ProvideMeshSpace(slot);
+        }
+
+        // Collect newly finished meshes from the completion queue
+        for (TerrainMeshData& mesh : chunkBuilder.TakeFinished()) {
+            builtChunks.push_back(move(mesh));
+        }
+
+        int uploads = 0;
+
+        while (!builtChunks.empty() && (maxUploads < 0 || uploads < maxUploads)) {
+            TerrainMeshData& front = builtChunks.front();
+            ChunkKey key{ front.chunkX, front.chunkZ };
+
+            bool loaded = terrainChunks.Find(key.x, key.z) != nullptr;
+            bool inRange = terrainChunks.InRange(key.x, key.z);
+
+            // Skip chunks the camera has moved away from, or duplicates of an already loaded chunk
+            if (loaded || !inRange) {
+                if (front.stagingSlot >= 0) {
+                    ProvideMeshSpace(front.stagingSlot);
+                }
+                pendingChunks.Erase(key.x, key.z);
+                builtChunks.pop_front();
+                continue;
+            }
+
+            // Wait for an unload to free a chunk slot or vertex buffer range
+            if (freeChunkSlots.empty()) {
+                break;
+            }
+            int baseVertex = -1;
+            if (TERRAIN_RENDER_MODE != TERRAIN_HEIGHTMAP_TEXTURE) {
+                baseVertex = terrainVertexAllocator.Allocate(TERRAIN_CHUNK_VERTICES);
+                if (baseVertex < 0) {
+                    break;
+                }
+            }
+
+            // Or, for heightmaps, for the GPU to finish copying earlier uploads out of the staging ring
+            StagingAllocation staging;
+            if (TERRAIN_RENDER_MODE == TERRAIN_HEIGHTMAP_TEXTURE) {
+                staging = stagingRing.Allocate((GLsizeiptr)HEIGHTFIELD_SIZE * HEIGHTFIELD_SIZE * sizeof(float));
+                if (!staging.data) {
+                    break;
+                }
+            }
+
+            TerrainMeshData mesh = move(front);
+            builtChunks.pop_front();
+
+            // Remember when the chunk was requested, for the benchmark's build latency
+            const PendingChunk* pending = pendingChunks.Find(key.x, key.z);
+            chrono::steady_clock::time_point requested = pending ? pending->requested : chrono::steady_clock::now();
+            bool prefetched = pending && pending->prefetched;
+            pendingChunks.Erase(key.x, key.z);
+
+            TerrainChunk chunk;
+            chunk.chunkX = key.x;
+            chunk.chunkZ = key.z;
+            chunk.heightfield = mesh.heightfield;
+            chunk.prefetched = prefetched;
+            chunk.slot = freeChunkSlots.back();
+            freeChunkSlots.pop_back();
+
+            if (TERRAIN_RENDER_MODE == TERRAIN_HEIGHTMAP_TEXTURE) {
+                chunk.terrain = CreateHeightmapTerrain(
+                    *mesh.heightfield,
+                    staging,
+                    heightmapArray, chunk.slot,
+                    terrainVertexArray, terrainIndexBuffer
+                );
+            }
+            else {
+                chunk.terrain = CreateTerrain(
+                    meshStaging.GetSlot(mesh.stagingSlot),
+                    terrainVertexArray, terrainVertexBuffer, baseVertex,
+                    terrainIndexBuffer
+                );
+                meshStaging.Release(mesh.stagingSlot);
+            }
+
+            chunk.water = CreateWater(
+                CHUNK_SIZE, CHUNK_SIZE, TILE_SIZE, key.x, key.z, 0.5f, waterTexture,
+                waterVertexArray, waterVertexBuffer, chunk.slot * WATER_CHUNK_VERTICES, waterIndexBuffer,
+                waterChunkBuffer, chunk.slot * waterChunkStride
+            );
+
+            // Add current chunk to chunk grid
+            terrainChunks.Insert(key.x, key.z, chunk);
+            terrainChunkDataDirty = true;
+            uploads++;
+
+            // Chunks loaded ahead of the camera are timed once they are needed, by which point they are ready
+            if (!prefetched) {
+                chunkLatencies.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - requested).count());
+            }
+        }
+
+        // Staging space of this call's uploads is reused once the GPU has copied it out
+        stagingRing.Fence();
+        meshStaging.Fence();
+
+        // Uploads bind textures directly
+        if (uploads > 0) {
+            glState.Invalidate();
+        }
+    }
+
+    // Give a mesh staging slot to the workers to build a chunk mesh into
+    void ProvideMeshSpace(int slot) {
+        chunkBuilder.ProvideMeshSpace(slot, meshStaging.GetSlot(slot).data);
+    }
+
+    // Upload chunks until every requested one has been built
+    void WaitForPendingChunks() {
+        while (!pendingChunks.Empty()) {
+            UploadBuiltChunks(-1);
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+
+    // Render target for headless runs
+    void CreateOffscreenFramebuffer() {
+        glGenRenderbuffers(1, &offscreenColour);
+        glBindRenderbuffer(GL_RENDERBUFFER, offscreenColour);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, windowWidth, windowHeight);
+
+        glGenRenderbuffers(1, &offscreenDepth);
+        glBindRenderbuffer(GL_RENDERBUFFER, offscreenDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, windowWidth, windowHeight);
+
+        // Stays bound for the rest of the run
+        glGenFramebuffers(1, &offscreenFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, offscreenFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, offscreenColour);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, offscreenDepth);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            cerr << "Failed to create offscreen framebuffer" << endl;
+        }
+    }
+
+    // Pixels covered by one world unit of height error, one unit away from the camera
+    float GetLodPixelScale() {
+        return windowHeight / (2.0f * tan(radians(FIELD_OF_VIEW) / 2.0f));
+    }
+
+    // Pick each chunk's LOD level from its projected height error, then size skirts to cover the gaps to its neighbours
+    void SelectTerrainLods() {
+        float pixelScale = GetLodPixelScale();
+        vec3 cameraPosition = camera.GetPos();
+
+        for (TerrainChunk& chunk : terrainChunks) {
+            if (!InRenderDistance(chunk.chunkX, chunk.chunkZ)) {
+                continue;
+            }
+            const ChunkHeightfield& field = *chunk.heightfield;
+
+            // Distance to the closest point of the chunk's bounds
+            vec3 boundsMin = vec3(chunk.chunkX * CHUNK_WORLD_SIZE, field.minHeight, chunk.chunkZ * CHUNK_WORLD_SIZE);
+            vec3 boundsMax = vec3(boundsMin.x + CHUNK_WORLD_SIZE, field.maxHeight, boundsMin.z + CHUNK_WORLD_SIZE);
+            float distance = length(cameraPosition - clamp(cameraPosition, boundsMin, boundsMax));
+
+            // Coarsest level that is still accurate enough
+            int lod = 0;
+            for (int level = TERRAIN_LOD_LEVELS - 1; level > 0; level--) {
+                if (field.lodError[level] * pixelScale <= TERRAIN_LOD_PIXEL_ERROR * distance) {
+                    lod = level;
+                    break;
                 }
             }
+            chunk.terrain.lod = lod;
         }
 
-        // Unload faraway chunks
-        for (auto it = terrainChunks.begin(); it != terrainChunks.end();) {
-            int dx = it->second.chunkX - cameraChunkX;
-            int dz = it->second.chunkZ - cameraChunkZ;
+        // Two edges can be apart by at most the sum of their errors, so each skirt covers its own error plus the worst neighbour's
+        for (TerrainChunk& chunk : terrainChunks) {
+            if (!InRenderDistance(chunk.chunkX, chunk.chunkZ)) {
+                continue;
+            }
+            ChunkKey neighbourKeys[] = {
+                { chunk.chunkX - 1, chunk.chunkZ }, { chunk.chunkX + 1, chunk.chunkZ },
+                { chunk.chunkX, chunk.chunkZ - 1 }, { chunk.chunkX, chunk.chunkZ + 1 }
+            };
+
+            float neighbourError = 0.0f;
+            for (const ChunkKey& key : neighbourKeys) {
+                const TerrainChunk* neighbour = FindVisibleChunk(key.x, key.z);
+                if (neighbour) {
+                    neighbourError = std::max(neighbourError, neighbour->heightfield->lodError[neighbour->terrain.lod]);
+                }
+            }
+            chunk.terrain.skirtDepth = chunk.heightfield->lodError[chunk.terrain.lod] + neighbourError;
+        }
+    }
 
-            // If chunk outside of render distance
-            if (abs(dx) > RENDER_DISTANCE || abs(dz) > RENDER_DISTANCE) {
-                // Delete GPU resources for chunk
-                glDeleteVertexArrays(1, &it->second.terrain.VAO);
-                glDeleteBuffers(1, &it->second.terrain.VBO);
-                glDeleteBuffers(1, &it->second.terrain.EBO);
-                glDeleteVertexArrays(1, &it->second.water.VAO);
-                glDeleteBuffers(1, &it->second.water.VBO);
-                glDeleteBuffers(1, &it->second.water.EBO);
+    // Rewrite the GPU culling entry of every chunk slot, free slots and chunks outside render distance are marked empty
+    void WriteTerrainChunkData() {
+        vector<TerrainChunkData> entries(MAX_LOADED_CHUNKS);
+        for (TerrainChunkData& entry : entries) {
+            entry.boundsMin = vec4(0.0f);
+        }
 
-                // Remove chunk from chunk map
-                it = terrainChunks.erase(it);
-            } else {
-                ++it;
+        for (const TerrainChunk& chunk : terrainChunks) {
+            if (!InRenderDistance(chunk.chunkX, chunk.chunkZ)) {
+                continue;
+            }
+            const ChunkHeightfield& field = *chunk.heightfield;
+            TerrainChunkData& entry = entries[chunk.slot];
+
+            vec3 origin = vec3(chunk.chunkX * CHUNK_WORLD_SIZE, 0.0f, chunk.chunkZ * CHUNK_WORLD_SIZE);
+            entry.model = chunk.terrain.modelMatrix;
+            entry.boundsMin = vec4(origin.x, field.minHeight, origin.z, 1.0f);
+            entry.boundsMax = vec4(origin.x + CHUNK_WORLD_SIZE, field.maxHeight, origin.z + CHUNK_WORLD_SIZE, 0.0f);
+            entry.info = ivec4(std::max(chunk.terrain.baseVertex, 0), chunk.terrain.heightmapLayer, 0, 0);
+
+            // Neighbours' slots, for sizing skirts to their LOD levels
+            ChunkKey neighbourKeys[] = {
+                { chunk.chunkX - 1, chunk.chunkZ }, { chunk.chunkX + 1, chunk.chunkZ },
+                { chunk.chunkX, chunk.chunkZ - 1 }, { chunk.chunkX, chunk.chunkZ + 1 }
+            };
+            for (int i = 0; i < 4; i++) {
+                const TerrainChunk* neighbour = FindVisibleChunk(neighbourKeys[i].x, neighbourKeys[i].z);
+                entry.neighbours[i] = neighbour ? neighbour->slot : -1;
+            }
+
+            for (int level = 0; level < TERRAIN_LOD_LEVELS; level++) {
+                entry.lodError[level] = field.lodError[level];
+                for (int node = 0; node < TERRAIN_PATCH_NODES; node++) {
+                    entry.patchHeights[level * TERRAIN_PATCH_NODES + node] = vec2(field.patchMinHeight[level][node], field.patchMaxHeight[level][node]);
+                }
             }
         }
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, terrainChunkBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, entries.size() * sizeof(TerrainChunkData), entries.data());
+        terrainChunkDataDirty = false;
+    }
+
+    // Heightfields of loaded chunks next to the given chunk, for sharing border samples
+    ChunkNeighbours GetLoadedNeighbours(int chunkX, int chunkZ) {
+        auto find = [this](int x, int z) {
+            const TerrainChunk* chunk = terrainChunks.Find(x, z);
+            return chunk ? chunk->heightfield : shared_ptr<const ChunkHeightfield>();
+        };
+
+        ChunkNeighbours neighbours;
+        neighbours.left = find(chunkX - 1, chunkZ);
+        neighbours.right = find(chunkX + 1, chunkZ);
+        neighbours.down = find(chunkX, chunkZ - 1);
+        neighbours.up = find(chunkX, chunkZ + 1);
+        return neighbours;
+    }
+
+    // Whether a chunk is close enough to the camera chunk to be drawn, loaded chunks further out are only kept resident
+    bool InRenderDistance(int chunkX, int chunkZ) const {
+        return abs(chunkX - terrainChunks.GetCentreX()) <= RENDER_DISTANCE && abs(chunkZ - terrainChunks.GetCentreZ()) <= RENDER_DISTANCE;
+    }
+
+    // Loaded chunk that is drawn, null when it is not loaded or outside render distance
+    const TerrainChunk* FindVisibleChunk(int chunkX, int chunkZ) const {
+        return InRenderDistance(chunkX, chunkZ) ? terrainChunks.Find(chunkX, chunkZ) : nullptr;
+    }
+
+    ChunkKey GetCameraChunk() {
+        vec3 cameraPosition = camera.GetPos();
+        return ChunkKey{
+            (int)floor(cameraPosition.x / CHUNK_WORLD_SIZE),
+            (int)floor(cameraPosition.z / CHUNK_WORLD_SIZE)
+        };
     }
 
     // Getters and Setters
+    const CullingStats& GetCullingStats() const { return cullingStats; }
+    const PrefetchStats& GetPrefetchStats() const { return prefetchStats; }
+    const ChunkCacheStats& GetChunkCacheStats() const { return chunkCache.GetStats(); }
     void SetWindowSize(int width, int height) {
         windowWidth = width;
         windowHeight = height;
         SetProjectionMatrix();
     }
     void SetProjectionMatrix() {
-        projection = perspective(radians(45.0f), (float)windowWidth / (float)windowHeight, 0.1f, 500.0f);
+        projection = perspective(radians(FIELD_OF_VIEW), (float)windowWidth / (float)windowHeight, 0.1f, VIEW_DISTANCE);
         glViewport(0, 0, windowWidth, windowHeight);
     }
 
 private:
     GLFWwindow* window;
-    GLuint program;
-    GLuint waterProgram;
+    bool headless;                      // Benchmark runs draw offscreen without a visible window
+    bool persistentCache;               // Read the chunk cache file at startup and save it at shutdown
+    bool gpuCulling;                    // TERRAIN_GPU_CULLING, when the driver has the extensions it needs
+    GLuint offscreenFramebuffer;
+    GLuint offscreenColour;
+    GLuint offscreenDepth;
+    ShaderProgram program;
+    ShaderProgram waterProgram;
+    GLuint frameDataBuffer;             // FrameData, rewritten once per frame
+    GLStateCache glState;               // Every state change made while rendering goes through it
 
     int windowWidth;
     int windowHeight;
     float deltaTime;
+    float fixedDeltaTime;               // Used instead of the measured frame time when above 0
     float lastFrame;
     float timeOfDay;
     float dayLength;
@@ -469,16 +1386,57 @@ private:
     vec3 previousCameraChunk;
 
     GLuint waterTexture;
-    GLuint sandTexture;
-    GLuint grassTexture;
-    GLuint rockTexture;
-    GLuint snowTexture;
-    GLuint sandNormal;
-    GLuint grassNormal;
-    GLuint rockNormal;
-    GLuint snowNormal;
-
-    unordered_map<ChunkKey, TerrainChunk, ChunkKeyHash> terrainChunks;
+    GLuint terrainDiffuse;              // Material texture arrays, one layer per material
+    GLuint terrainNormals;
+
+    GLuint terrainIndexBuffer;          // Shared by every terrain chunk
+    vector<TerrainPatch> terrainPatches;     // TERRAIN_PATCH_NODES sub-patches per LOD level
+
+    // Every chunk mesh lives in one vertex buffer, drawn with one glMultiDrawElementsIndirect call
+    GLuint terrainVertexArray;
+    GLuint terrainVertexBuffer;
+    GLuint terrainDrawIndexBuffer;      // 0 to TERRAIN_MAX_DRAWS - 1, only created when gl_DrawID is not available
+    BufferAllocator terrainVertexAllocator;     // Ranges of terrainVertexBuffer, in vertices
+    GLuint terrainCommandBuffer;        // Indirect draw commands
+    GLuint terrainDrawBuffer;           // Per draw TerrainDrawData, indexed by gl_DrawID
+    vector<int> freeChunkSlots;         // Chunk slots (heightmap layers, GPU culling entries, water quads) not used by a loaded chunk
+
+    // gpuCulling resources
+    ShaderProgram cullProgram;
+    GLuint terrainChunkBuffer;          // TerrainChunkData of every chunk slot
+    GLuint terrainPatchBuffer;          // Copy of terrainPatches
+    GLuint terrainCounterBuffer;        // Draw count and culling statistics
+    GLuint terrainOrderBuffer;          // Chunk slots nearest first, from the render list
+    bool terrainChunkDataDirty;         // Chunks were loaded or unloaded since the chunk buffer was written
+
+    // Every water quad lives in one vertex buffer, at its chunk's slot
+    GLuint waterVertexArray;
+    GLuint waterVertexBuffer;
+    GLuint waterIndexBuffer;
+    GLuint waterChunkBuffer;            // WaterChunkData of every chunk slot, waterChunkStride bytes apart
+    GLintptr waterChunkStride;
+
+    // Frustum culling results, rebuilt every frame
+    RenderList renderList;
+    vector<VisibleTerrainChunk> visibleTerrain;
+    vector<DrawElementsIndirectCommand> terrainCommands;    // One draw per visible sub-patch range
+    vector<TerrainDrawData> terrainDrawData;                // Data of each draw's chunk
+    BoxList chunkBoxes;
+    BoxList waterBoxes;
+    CullingStats cullingStats;
+
+    // TERRAIN_HEIGHTMAP_TEXTURE resources
+    GLuint heightmapArray;
+
+    ChunkGrid<TerrainChunk> terrainChunks;                  // Loaded chunks within RESIDENT_DISTANCE of the camera chunk, drawn within RENDER_DISTANCE
+    ChunkGrid<PendingChunk> pendingChunks;                  // Chunks requested from the worker threads but not yet uploaded
+    PrefetchStats prefetchStats;
+    ChunkCache chunkCache;                                  // Heightfields of unloaded chunks
+    vector<double> chunkLatencies;                          // Request to upload times (ms) of chunks uploaded since last cleared
+    deque<TerrainMeshData> builtChunks;                     // Finished chunks waiting for their turn to upload
+    StagingRing stagingRing;                                // Upload space for heightfields
+    StagingPool meshStaging;                                // Mapped space chunk meshes are built in
+    ChunkBuilder chunkBuilder;
     RenderWaterObject Water;
 
     mat4 projection;
@@ -495,146 +1453,191 @@ void FramebufferSizeCallback(GLFWwindow* window, int width, int height) {
     }
 }
 
-RenderTerrainObject CreateTerrain(
-    int gridWidth, int gridDepth, float tileSize, int chunkX, int chunkZ,
-    GLuint sandTexture, GLuint sandNormal,
-    GLuint grassTexture, GLuint grassNormal,
-    GLuint rockTexture, GLuint rockNormal,
-    GLuint snowTexture, GLuint snowNormal
-)
-{
-    RenderTerrainObject object;
+GLuint CreateTerrainIndexBuffer(int gridWidth, int gridDepth, vector<TerrainPatch>& patches) {
+    vector<uint16_t> indices;
+    patches.assign(TERRAIN_LOD_LEVELS * TERRAIN_PATCH_NODES, TerrainPatch());
 
-    vector<float> vertices;
-    vector<unsigned int> indices;
+    // Every LOD level one after another
+    for (int level = 0; level < TERRAIN_LOD_LEVELS; level++) {
+        TerrainPatch* levelPatches = &patches[level * TERRAIN_PATCH_NODES];
+        vector<uint16_t> levelIndices = BuildTerrainIndices(gridWidth, gridDepth, TERRAIN_LOD_STRIDES[level], levelPatches);
 
-    float offsetX = chunkX * (gridWidth * tileSize + 5.0f);
-    float offsetZ = chunkZ * (gridDepth * tileSize + 5.0f);
+        for (int node = 0; node < TERRAIN_PATCH_NODES; node++) {
+            levelPatches[node].firstIndex += (unsigned int)indices.size();
+        }
+        indices.insert(indices.end(), levelIndices.begin(), levelIndices.end());
+    }
 
-    // Generate vertices
-    for (int z = 0; z <= gridDepth; z++) {
-        for (int x = 0; x <= gridWidth; x++) {
-            float worldX = offsetX + x * tileSize;
-            float worldZ = offsetZ + z * tileSize;
+    // Immutable storage, the indices never change after creation
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer);
+    glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
-            vec3 normal = GenerateNormal(worldX, worldZ);
+    return buffer;
+}
 
-            // positions
-            vertices.push_back(worldX);
-            vertices.push_back(GenerateHeight(worldX, worldZ));
-            vertices.push_back(worldZ);
+GLuint CreateDrawIndexBuffer(int maxDraws) {
+    vector<GLuint> drawIndices(maxDraws);
+    for (int draw = 0; draw < maxDraws; draw++) {
+        drawIndices[draw] = (GLuint)draw;
+    }
 
-            // normals
-            vertices.push_back(normal.x);
-            vertices.push_back(normal.y);
-            vertices.push_back(normal.z);
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferStorage(GL_ARRAY_BUFFER, drawIndices.size() * sizeof(GLuint), drawIndices.data(), 0);
+    return buffer;
+}
 
-            // textures
-            vertices.push_back(worldX);
-            vertices.push_back(worldZ);
-        }
-    }
+GLuint CreateTerrainVertexArray(GLuint indexBuffer, GLuint& vertexBuffer, GLuint drawIndexBuffer, int maxChunks) {
+    GLuint VAO;
 
-    // Generate indices
-    for (int z = 0; z < gridDepth; z++) {
-        for (int x = 0; x < gridWidth; x++) {
-            int topLeft = z * (gridWidth + 1) + x;
-            int topRight = topLeft + 1;
-            int bottomLeft = (z + 1) * (gridWidth + 1) + x;
-            int bottomRight = bottomLeft + 1;
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
 
-            // first triangle
-            indices.push_back(topLeft);
-            indices.push_back(bottomLeft);
-            indices.push_back(topRight);
+    // Index data, shared buffer recorded in the VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
 
-            // second triangle
-            indices.push_back(topRight);
-            indices.push_back(bottomLeft);
-            indices.push_back(bottomRight);
-        }
+    // Draw index data, one value per instance. Every draw is a single instance starting at its baseInstance, which
+    // holds the draw's index
+    if (drawIndexBuffer != 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, drawIndexBuffer);
+        glVertexAttribIPointer(5, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+        glVertexAttribDivisor(5, 1);
+        glEnableVertexAttribArray(5);
     }
-    object.indexCount = (unsigned int)indices.size();
 
-    // Generate VAO/VBO/EBO
-    glGenVertexArrays(1, &object.VAO);
-    glGenBuffers(1, &object.VBO);
-    glGenBuffers(1, &object.EBO);
-    glBindVertexArray(object.VAO);
+    // Heightmap vertex positions come from gl_VertexID and the height texture, so there is no vertex data
+    if (TERRAIN_RENDER_MODE == TERRAIN_HEIGHTMAP_TEXTURE) {
+        vertexBuffer = 0;
+        glBindVertexArray(0);
+        return VAO;
+    }
 
-    // Vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, object.VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    // Vertex data, room for every loaded chunk, filled a chunk at a time
+    glGenBuffers(1, &vertexBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferStorage(GL_ARRAY_BUFFER, (GLsizeiptr)maxChunks * TERRAIN_CHUNK_VERTICES * TERRAIN_VERTEX_SIZE, nullptr, GL_DYNAMIC_STORAGE_BIT);
 
-    // Index data
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    if (TERRAIN_RENDER_MODE == TERRAIN_COMPACT_VERTICES) {
+        // Quantized height data
+        glVertexAttribPointer(3, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactTerrainVertex), (void*)offsetof(CompactTerrainVertex, height));
+        glEnableVertexAttribArray(3);
 
-    // Position data
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+        // Octahedral normal data
+        glVertexAttribPointer(4, 2, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactTerrainVertex), (void*)offsetof(CompactTerrainVertex, normal));
+        glEnableVertexAttribArray(4);
+    }
+    else {
+        // Position data
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
 
-    // Normal data
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
+        // Normal data
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
 
-    // Texture data
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+        // Texture data
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+    }
+
+    glBindVertexArray(0);
+    return VAO;
+}
+
+RenderTerrainObject CreateTerrain(
+    const StagingAllocation& staging,
+    GLuint vertexArray, GLuint vertexBuffer, int baseVertex,
+    GLuint indexBuffer
+)
+{
+    RenderTerrainObject object;
 
-    // Assign textures
-    object.sandTexture = sandTexture;
-    object.grassTexture = grassTexture;
-    object.rockTexture = rockTexture;
-    object.snowTexture = snowTexture;
+    // Buffers are shared by every chunk
+    object.VAO = vertexArray;
+    object.VBO = vertexBuffer;
+    object.EBO = indexBuffer;
+    object.baseVertex = baseVertex;
 
-    // Assign normals
-    object.sandNormal = sandNormal;
-    object.grassNormal = grassNormal;
-    object.rockNormal = rockNormal;
-    object.snowNormal = snowNormal;
+    // Vertex data was built in the staging space, the GPU copies it into the chunk's range of the shared buffer
+    const GLsizeiptr vertexBytes = (GLsizeiptr)TERRAIN_CHUNK_VERTICES * TERRAIN_VERTEX_SIZE;
+
+    glBindBuffer(GL_COPY_READ_BUFFER, staging.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, staging.offset, (GLintptr)baseVertex * TERRAIN_VERTEX_SIZE, vertexBytes);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
 
-    glBindVertexArray(0);
     return object;
 }
 
-RenderWaterObject CreateWater(int gridWidth, int gridDepth, float tileSize, int chunkX, int chunkZ, float alpha, GLuint waterTexture) {
-    RenderWaterObject object;
-    object.alpha = alpha;
+GLuint CreateHeightmapArray(int layers) {
+    GLuint textureID;
 
-    float sizeX = gridWidth * tileSize;
-    float sizeZ = gridDepth * tileSize;
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
 
-    float offsetX = chunkX * (sizeX + 5.0f);
-    float offsetZ = chunkZ * (sizeZ + 5.0f);
+    // Full precision heights, the vertex shader only ever reads exact texels
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_R32F, HEIGHTFIELD_SIZE, HEIGHTFIELD_SIZE, layers);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    float vertices[] = {
-        // positions                                    // textures
-        offsetX + sizeX, WATER_LEVEL, offsetZ + sizeZ,  sizeX, sizeZ,   // top right
-        offsetX + sizeX, WATER_LEVEL, offsetZ,          sizeX, 0.0f,    // bottom right
-        offsetX,         WATER_LEVEL, offsetZ,          0.0f,  0.0f,    // bottom left
-        offsetX,         WATER_LEVEL, offsetZ + sizeZ,  0.0f,  sizeZ    // top left
-    };
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return textureID;
+}
+
+RenderTerrainObject CreateHeightmapTerrain(
+    const ChunkHeightfield& field,
+    const StagingAllocation& staging,
+    GLuint heightmapArray, int layer,
+    GLuint vertexArray, GLuint indexBuffer
+)
+{
+    RenderTerrainObject object;
+
+    // Grid geometry is shared by every chunk
+    object.VAO = vertexArray;
+    object.EBO = indexBuffer;
+    object.heightmapLayer = layer;
+
+    // Height data, apron included so the shader can take normals at the chunk's edge vertices.
+    // Staged, then read from the staging buffer (bound as the unpack buffer, so the pointer is an offset into it)
+    memcpy(staging.data, field.heights.data(), field.heights.size() * sizeof(float));
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging.buffer);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, heightmapArray);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, HEIGHTFIELD_SIZE, HEIGHTFIELD_SIZE, 1, GL_RED, GL_FLOAT, (const void*)staging.offset);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    return object;
+}
+
+GLuint CreateWaterVertexArray(GLuint& vertexBuffer, GLuint& indexBuffer, int maxChunks) {
+    GLuint VAO;
 
-    unsigned int indices[] = {
+    unsigned int indices[WATER_CHUNK_INDICES] = {
         0, 1, 3,    // first triangle
         1, 2, 3     // second triangle
     };
-    object.indexCount = 6;
 
-    // Generate VAO/VBO/EBO
-    glGenVertexArrays(1, &object.VAO);
-    glGenBuffers(1, &object.VBO);
-    glGenBuffers(1, &object.EBO);
-    glBindVertexArray(object.VAO);
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &vertexBuffer);
+    glGenBuffers(1, &indexBuffer);
+    glBindVertexArray(VAO);
 
-    // Vertex data
-    glBindBuffer(GL_ARRAY_BUFFER, object.VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    // Vertex data, one quad per chunk slot, refilled whenever a chunk takes the slot
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferStorage(GL_ARRAY_BUFFER, (GLsizeiptr)maxChunks * WATER_CHUNK_VERTICES * 5 * sizeof(float), nullptr, GL_DYNAMIC_STORAGE_BIT);
 
-    // Index data
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, object.EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    // Index data, the same for every quad which is picked with its base vertex
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, 0);
 
     // Position data
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -644,44 +1647,60 @@ RenderWaterObject CreateWater(int gridWidth, int gridDepth, float tileSize, int
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    // Assign texture
-    object.texture = waterTexture;
-
     glBindVertexArray(0);
-    return object;
+    return VAO;
 }
 
-float GenerateHeight(float x, float z) {
-    float baseFrequency = 0.02f;    // Higher value = More hills
-    float baseAmplitude = 25.0f;    // Higher value = Bigger hills
+RenderWaterObject CreateWater(
+    int gridWidth, int gridDepth, float tileSize, int chunkX, int chunkZ, float alpha, GLuint waterTexture,
+    GLuint vertexArray, GLuint vertexBuffer, int baseVertex, GLuint indexBuffer,
+    GLuint dataBuffer, GLintptr dataOffset
+)
+{
+    RenderWaterObject object;
+    object.alpha = alpha;
 
-    float height = 0.0f;        // Accumlated height
-    float persistence = 0.35f;  // Amplitude scaling for each octave
-    int octaves = 6;            // Higher value = more terrain detail
+    // Buffers are shared by every chunk
+    object.VAO = vertexArray;
+    object.VBO = vertexBuffer;
+    object.EBO = indexBuffer;
+    object.baseVertex = baseVertex;
 
-    for (int i = 0; i < octaves; i++) {
-        // Frequency increases per octave
-        float frequency = baseFrequency * (float)pow(2.0f, i);
+    float sizeX = gridWidth * tileSize;
+    float sizeZ = gridDepth * tileSize;
 
-        // Amplitude decreases per octave
-        float amplitude = baseAmplitude * (float)pow(persistence, i);
+    float offsetX = chunkX * sizeX;
+    float offsetZ = chunkZ * sizeZ;
 
-        // Use glm to generate perlin noise and multiply by amplitude
-        height += perlin(vec2(x * frequency, z * frequency)) * amplitude;
-    }
+    float vertices[] = {
+        // positions                                    // textures
+        offsetX + sizeX, WATER_LEVEL, offsetZ + sizeZ,  sizeX, sizeZ,   // top right
+        offsetX + sizeX, WATER_LEVEL, offsetZ,          sizeX, 0.0f,    // bottom right
+        offsetX,         WATER_LEVEL, offsetZ,          0.0f,  0.0f,    // bottom left
+        offsetX,         WATER_LEVEL, offsetZ + sizeZ,  0.0f,  sizeZ    // top left
+    };
 
-    return height;
-}
+    object.indexCount = WATER_CHUNK_INDICES;
 
-vec3 GenerateNormal(float x, float z) {
-    float heightL = GenerateHeight(x - 1.0f, z);
-    float heightR = GenerateHeight(x + 1.0f, z);
-    float heightD = GenerateHeight(x, z - 1.0f);
-    float heightU = GenerateHeight(x, z + 1.0f);
+    // Vertex data, refilled in place
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)baseVertex * 5 * sizeof(float), sizeof(vertices), vertices);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-    vec3 normal = vec3(heightL - heightR, 2.0f, heightD - heightU);
+    // Chunk data the shaders read while it is drawn
+    WaterChunkData data = {};
+    data.model = object.modelMatrix;
+    data.alpha = object.alpha;
+    object.dataOffset = dataOffset;
 
-    return normalize(normal);
+    glBindBuffer(GL_UNIFORM_BUFFER, dataBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, dataOffset, sizeof(data), &data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    // Assign texture
+    object.texture = waterTexture;
+
+    return object;
 }
 
 GLuint LoadTexture(const string& texturePath) {
@@ -715,12 +1734,160 @@ GLuint LoadTexture(const string& texturePath) {
 }
 
 
+GLuint LoadTexture(const vector<string>& texturePaths) {
+    GLuint textureID;
+
+    glGenTextures(1, &textureID);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+
+    // Enable texture wrapping
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    const int layers = (int)texturePaths.size();
+    vector<unsigned char*> images(layers, nullptr);
+    vector<ivec2> sizes(layers, ivec2(0));
+
+    // Every layer is resampled to the largest image
+    ivec2 size(0);
+    for (int layer = 0; layer < layers; layer++) {
+        int colourChannels;
+        images[layer] = stbi_load(texturePaths[layer].c_str(), &sizes[layer].x, &sizes[layer].y, &colourChannels, 3);
+
+        // Missing images leave their layer black
+        if (!images[layer]) {
+            cerr << "Failed to load texture: " << texturePaths[layer] << endl;
+            continue;
+        }
+
+        size = glm::max(size, sizes[layer]);
+    }
+
+    if (size.x > 0) {
+        int levels = 1;
+        while ((std::max(size.x, size.y) >> levels) > 0) {
+            levels++;
+        }
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGB8, size.x, size.y, layers);
+
+        vector<unsigned char> black;
+        for (int layer = 0; layer < layers; layer++) {
+            const unsigned char* data = images[layer];
+
+            vector<unsigned char> resampled;
+            if (!data) {
+                black.resize((size_t)size.x * size.y * 3, 0);
+                data = black.data();
+            }
+            else if (sizes[layer] != size) {
+                resampled = ResampleImage(data, sizes[layer].x, sizes[layer].y, size.x, size.y);
+                data = resampled.data();
+            }
+
+            // Upload texture to GPU
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, size.x, size.y, 1, GL_RGB, GL_UNSIGNED_BYTE, data);
+        }
+
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+
+    for (unsigned char* image : images) {
+        stbi_image_free(image);
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return textureID;
+}
+
+// Source texels and weights making up each texel along one axis of a resampled image, wrapping like GL_REPEAT
+static vector<vector<pair<int, float>>> ResampleWeights(int sourceSize, int resampledSize) {
+    vector<vector<pair<int, float>>> taps(resampledSize);
+
+    float scale = (float)sourceSize / resampledSize;
+    float radius = std::max(1.0f, scale);
+
+    for (int i = 0; i < resampledSize; i++) {
+        float centre = (i + 0.5f) * scale - 0.5f;
+
+        float total = 0.0f;
+        for (int j = (int)ceil(centre - radius); j <= (int)floor(centre + radius); j++) {
+            float weight = 1.0f - abs(j - centre) / radius;
+            if (weight <= 0.0f) {
+                continue;
+            }
+
+            taps[i].push_back(make_pair(((j % sourceSize) + sourceSize) % sourceSize, weight));
+            total += weight;
+        }
+
+        for (pair<int, float>& tap : taps[i]) {
+            tap.second /= total;
+        }
+    }
+
+    return taps;
+}
+
+vector<unsigned char> ResampleImage(const unsigned char* data, int width, int height, int newWidth, int newHeight) {
+    vector<vector<pair<int, float>>> columns = ResampleWeights(width, newWidth);
+    vector<vector<pair<int, float>>> rows = ResampleWeights(height, newHeight);
+
+    // Resample each row, then each column of the result
+    vector<float> horizontal((size_t)newWidth * height * 3, 0.0f);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < newWidth; x++) {
+            float* texel = &horizontal[((size_t)y * newWidth + x) * 3];
+            for (const pair<int, float>& tap : columns[x]) {
+                const unsigned char* source = &data[((size_t)y * width + tap.first) * 3];
+                for (int c = 0; c < 3; c++) {
+                    texel[c] += source[c] * tap.second;
+                }
+            }
+        }
+    }
+
+    vector<unsigned char> resampled((size_t)newWidth * newHeight * 3);
+    for (int y = 0; y < newHeight; y++) {
+        for (int x = 0; x < newWidth; x++) {
+            float texel[3] = { 0.0f, 0.0f, 0.0f };
+            for (const pair<int, float>& tap : rows[y]) {
+                const float* source = &horizontal[((size_t)tap.first * newWidth + x) * 3];
+                for (int c = 0; c < 3; c++) {
+                    texel[c] += source[c] * tap.second;
+                }
+            }
+
+            for (int c = 0; c < 3; c++) {
+                resampled[((size_t)y * newWidth + x) * 3 + c] = (unsigned char)glm::clamp(texel[c] + 0.5f, 0.0f, 255.0f);
+            }
+        }
+    }
+
+    return resampled;
+}
+
 int main(int argc, char* argv[]) {
+    BenchmarkSettings benchmark = ParseBenchmarkArguments(argc, argv);
+    if (!benchmark.valid) {
+        return 1;
+    }
+
     Game game;
-    game.Initialise();
+    if (!game.Initialise(benchmark.enabled, !benchmark.enabled || benchmark.persistentCache)) {
+        return 1;
+    }
 
-    game.Run();
+    bool succeeded = true;
+    if (benchmark.enabled) {
+        succeeded = game.RunBenchmark(benchmark);
+    }
+    else {
+        game.Run();
+    }
 
     game.CleanUp();
-    return 0;
+    return succeeded ? 0 : 1;
 }
@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "Frustum.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define FRUSTUM_HAS_SSE2 0
+#endif
+
+using namespace std;
+using namespace glm;
+
+
+Frustum ExtractFrustum(const mat4& viewProjection) {
+    // Rows of the matrix (glm is column major)
+    vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    }
+
+    // Clip space -w <= x, y, z <= w, one plane per side
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];     // Left
+    frustum.planes[1] = rows[3] - rows[0];     // Right
+    frustum.planes[2] = rows[3] + rows[1];     // Bottom
+    frustum.planes[3] = rows[3] - rows[1];     // Top
+    frustum.planes[4] = rows[3] + rows[2];     // Near
+    frustum.planes[5] = rows[3] - rows[2];     // Far
+
+    return frustum;
+}
+
+// Test one box, used for whatever is left over after the SIMD batches
+static FrustumTest TestBox(const Frustum& frustum, const BoxList& boxes, int i) {
+    bool inside = true;
+
+    for (const vec4& plane : frustum.planes) {
+        // Distance of the box corners furthest along (p) and against (n) the plane normal
+        float x0 = plane.x * boxes.minX[i], x1 = plane.x * boxes.maxX[i];
+        float y0 = plane.y * boxes.minY[i], y1 = plane.y * boxes.maxY[i];
+        float z0 = plane.z * boxes.minZ[i], z1 = plane.z * boxes.maxZ[i];
+
+        float p = std::max(x0, x1) + std::max(y0, y1) + std::max(z0, z1) + plane.w;
+        float n = std::min(x0, x1) + std::min(y0, y1) + std::min(z0, z1) + plane.w;
+
+        if (p < 0.0f) {
+            return FRUSTUM_OUTSIDE;
+        }
+        if (n < 0.0f) {
+            inside = false;
+        }
+    }
+
+    return inside ? FRUSTUM_INSIDE : FRUSTUM_INTERSECTS;
+}
+
+void TestBoxes(const Frustum& frustum, const BoxList& boxes, FrustumTest* results) {
+    int count = boxes.Size();
+    int i = 0;
+
+#if FRUSTUM_HAS_SSE2
+    // Same test as TestBox on 4 boxes per register, without branching per plane
+    const __m128 zero = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 minX = _mm_loadu_ps(&boxes.minX[i]), maxX = _mm_loadu_ps(&boxes.maxX[i]);
+        __m128 minY = _mm_loadu_ps(&boxes.minY[i]), maxY = _mm_loadu_ps(&boxes.maxY[i]);
+        __m128 minZ = _mm_loadu_ps(&boxes.minZ[i]), maxZ = _mm_loadu_ps(&boxes.maxZ[i]);
+
+        __m128 outside = zero;
+        __m128 intersects = zero;
+
+        for (const vec4& plane : frustum.planes) {
+            __m128 a = _mm_set1_ps(plane.x), b = _mm_set1_ps(plane.y), c = _mm_set1_ps(plane.z), d = _mm_set1_ps(plane.w);
+
+            __m128 x0 = _mm_mul_ps(a, minX), x1 = _mm_mul_ps(a, maxX);
+            __m128 y0 = _mm_mul_ps(b, minY), y1 = _mm_mul_ps(b, maxY);
+            __m128 z0 = _mm_mul_ps(c, minZ), z1 = _mm_mul_ps(c, maxZ);
+
+            __m128 p = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_max_ps(z0, z1)), d);
+            __m128 n = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_min_ps(z0, z1)), d);
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(p, zero));
+            intersects = _mm_or_ps(intersects, _mm_cmplt_ps(n, zero));
+        }
+
+        int outsideMask = _mm_movemask_ps(outside);
+        int intersectsMask = _mm_movemask_ps(intersects);
+        for (int lane = 0; lane < 4; lane++) {
+            if (outsideMask & (1 << lane)) {
+                results[i + lane] = FRUSTUM_OUTSIDE;
+            }
+            else {
+                results[i + lane] = (intersectsMask & (1 << lane)) ? FRUSTUM_INTERSECTS : FRUSTUM_INSIDE;
+            }
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        results[i] = TestBox(frustum, boxes, i);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <glm/glm/ext/matrix_float4x4.hpp>
+#include <glm/glm/ext/vector_float3.hpp>
+#include <glm/glm/ext/vector_float4.hpp>
+
+
+// Result of testing a box against the view frustum
+enum FrustumTest : uint8_t {
+    FRUSTUM_OUTSIDE = 0,
+    FRUSTUM_INTERSECTS = 1,     // Partly inside, children of the box may still be culled
+    FRUSTUM_INSIDE = 2
+};
+
+// View frustum as six inward facing planes, a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Axis aligned boxes stored one array per component, so several can be tested at once
+struct BoxList {
+    std::vector<float> minX, minY, minZ;
+    std::vector<float> maxX, maxY, maxZ;
+
+    void Clear() {
+        minX.clear(); minY.clear(); minZ.clear();
+        maxX.clear(); maxY.clear(); maxZ.clear();
+    }
+
+    void Add(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+        minX.push_back(boxMin.x); minY.push_back(boxMin.y); minZ.push_back(boxMin.z);
+        maxX.push_back(boxMax.x); maxY.push_back(boxMax.y); maxZ.push_back(boxMax.z);
+    }
+
+    int Size() const { return (int)minX.size(); }
+};
+
+// Function to extract the frustum planes from a combined projection * view matrix
+Frustum ExtractFrustum(const glm::mat4& viewProjection);
+
+// Function to test every box in the list against the frustum, writing one result per box.
+// Tests 4 boxes at a time with SSE2 when available.
+void TestBoxes(const Frustum& frustum, const BoxList& boxes, FrustumTest* results);
@@ -0,0 +1,118 @@
+#include "GLStateCache.h"
+
+using namespace std;
+
+
+GLStateCache::GLStateCache() {
+    Invalidate();
+}
+
+void GLStateCache::Invalidate() {
+    activeUnit = UNKNOWN;
+    for (unordered_map<GLenum, GLuint>& unit : textures) {
+        unit.clear();
+    }
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    capabilities.clear();
+    blendSource = UNKNOWN;
+    blendDestination = UNKNOWN;
+    depthMask = UNKNOWN;
+}
+
+bool GLStateCache::Count(GLStateCall call, bool changed) {
+    if (changed) {
+        stats.issued[call]++;
+    }
+    else {
+        stats.elided[call]++;
+    }
+    return changed;
+}
+
+void GLStateCache::ActiveTexture(GLenum unit) {
+    if (Count(STATE_CALL_ACTIVE_TEXTURE, unit != activeUnit)) {
+        glActiveTexture(unit);
+        activeUnit = unit;
+    }
+}
+
+void GLStateCache::BindTexture(GLenum unit, GLenum target, GLuint texture) {
+    int index = (int)(unit - GL_TEXTURE0);
+
+    // Units past the tracked range are always bound
+    if (index < 0 || index >= MAX_TEXTURE_UNITS) {
+        ActiveTexture(unit);
+        Count(STATE_CALL_BIND_TEXTURE, true);
+        glBindTexture(target, texture);
+        return;
+    }
+
+    unordered_map<GLenum, GLuint>::iterator bound = textures[index].find(target);
+    if (!Count(STATE_CALL_BIND_TEXTURE, bound == textures[index].end() || bound->second != texture)) {
+        return;
+    }
+
+    ActiveTexture(unit);
+    glBindTexture(target, texture);
+    textures[index][target] = texture;
+}
+
+void GLStateCache::UseProgram(GLuint newProgram) {
+    if (Count(STATE_CALL_USE_PROGRAM, newProgram != program)) {
+        glUseProgram(newProgram);
+        program = newProgram;
+    }
+}
+
+void GLStateCache::BindVertexArray(GLuint newVertexArray) {
+    if (Count(STATE_CALL_BIND_VERTEX_ARRAY, newVertexArray != vertexArray)) {
+        glBindVertexArray(newVertexArray);
+        vertexArray = newVertexArray;
+    }
+}
+
+void GLStateCache::SetCapability(GLenum capability, bool enabled) {
+    unordered_map<GLenum, bool>::iterator current = capabilities.find(capability);
+    if (!Count(STATE_CALL_CAPABILITY, current == capabilities.end() || current->second != enabled)) {
+        return;
+    }
+
+    if (enabled) {
+        glEnable(capability);
+    }
+    else {
+        glDisable(capability);
+    }
+    capabilities[capability] = enabled;
+}
+
+void GLStateCache::BlendFunc(GLenum source, GLenum destination) {
+    if (Count(STATE_CALL_BLEND_FUNC, source != blendSource || destination != blendDestination)) {
+        glBlendFunc(source, destination);
+        blendSource = source;
+        blendDestination = destination;
+    }
+}
+
+void GLStateCache::DepthMask(bool enabled) {
+    GLuint mask = enabled ? GL_TRUE : GL_FALSE;
+    if (Count(STATE_CALL_DEPTH_MASK, mask != depthMask)) {
+        glDepthMask((GLboolean)mask);
+        depthMask = mask;
+    }
+}
+
+
+const char* GetStateCallName(GLStateCall call) {
+    switch (call) {
+    case STATE_CALL_ACTIVE_TEXTURE: return "activeTexture";
+    case STATE_CALL_BIND_TEXTURE: return "bindTexture";
+    case STATE_CALL_USE_PROGRAM: return "useProgram";
+    case STATE_CALL_BIND_VERTEX_ARRAY: return "bindVertexArray";
+    case STATE_CALL_CAPABILITY: return "capability";
+    case STATE_CALL_BLEND_FUNC: return "blendFunc";
+    case STATE_CALL_DEPTH_MASK: return "depthMask";
+    default: return "unknown";
+    }
+}
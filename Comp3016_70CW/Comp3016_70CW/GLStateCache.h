@@ -0,0 +1,78 @@
+#pragma once
+#include <unordered_map>
+#include <GL/glew.h>
+
+using namespace std;
+
+
+// Kinds of state change filtered by the state cache
+enum GLStateCall {
+    STATE_CALL_ACTIVE_TEXTURE = 0,
+    STATE_CALL_BIND_TEXTURE,
+    STATE_CALL_USE_PROGRAM,
+    STATE_CALL_BIND_VERTEX_ARRAY,
+    STATE_CALL_CAPABILITY,          // glEnable and glDisable
+    STATE_CALL_BLEND_FUNC,
+    STATE_CALL_DEPTH_MASK,
+    STATE_CALL_TYPES
+};
+
+// State changes passed on to GL and dropped as redundant, by kind
+struct GLStateStats {
+    int issued[STATE_CALL_TYPES];
+    int elided[STATE_CALL_TYPES];
+
+    GLStateStats() : issued(), elided() {}
+};
+
+
+// Shadow copy of the GL state the render loop changes, calls that would set what is already set are dropped.
+// Only sees changes made through it, after GL state was changed directly (e.g. binding a texture to upload to it)
+// Invalidate has to be called, which makes the next call of every kind go through.
+class GLStateCache {
+public:
+    GLStateCache();
+
+    // Forget the tracked state
+    void Invalidate();
+
+    void ActiveTexture(GLenum unit);
+
+    // Bind a texture to a unit (GL_TEXTURE0 + i), selecting the unit first if needed
+    void BindTexture(GLenum unit, GLenum target, GLuint texture);
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vertexArray);
+
+    // glEnable or glDisable
+    void SetCapability(GLenum capability, bool enabled);
+
+    void BlendFunc(GLenum source, GLenum destination);
+    void DepthMask(bool enabled);
+
+    // Getters and Setters
+    const GLStateStats& GetStats() const { return stats; }
+    void ResetStats() { stats = GLStateStats(); }
+
+private:
+    // Count a call, true if it has to be passed on
+    bool Count(GLStateCall call, bool changed);
+
+    static const int MAX_TEXTURE_UNITS = 32;
+    static const GLuint UNKNOWN = ~(GLuint)0;       // Not set through the cache since the last Invalidate
+
+    // Missing map entries are unknown too
+    GLenum activeUnit;
+    unordered_map<GLenum, GLuint> textures[MAX_TEXTURE_UNITS];     // Bound texture of each target, per unit
+    GLuint program;
+    GLuint vertexArray;
+    unordered_map<GLenum, bool> capabilities;
+    GLenum blendSource;
+    GLenum blendDestination;
+    GLuint depthMask;
+    GLStateStats stats;
+};
+
+
+// Function to name a kind of state change for benchmark output
+const char* GetStateCallName(GLStateCall call);
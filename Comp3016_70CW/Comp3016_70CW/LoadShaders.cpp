@@ -4,6 +4,7 @@
 //
 //////////////////////////////////////////////////////////////////////////////
 
+#include <cstdio>
 #include <cstdlib>
 #include <iostream>
 
@@ -21,7 +22,11 @@ extern "C" {
 	{
 
 		FILE* infile;
+#ifdef _MSC_VER
 		fopen_s(&infile, filename, "rb");
+#else
+		infile = fopen(filename, "rb");
+#endif
 
 
 		if (!infile) {
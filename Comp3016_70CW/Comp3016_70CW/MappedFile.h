@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+
+// Read only memory mapping of a whole file. Pages are loaded by the OS as they are touched, so a large file costs
+// nothing until it is read and its data is never copied into a buffer of our own.
+class MappedFile {
+public:
+    MappedFile();
+    ~MappedFile();
+
+    // Map a file, false when it is missing, empty or cannot be mapped
+    bool Open(const string& path);
+
+    // Unmap the file, data pointers handed out before become invalid
+    void Close();
+
+    // Getters
+    bool IsOpen() const { return data != nullptr; }
+    const uint8_t* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+private:
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data;
+    size_t size;
+#ifdef _WIN32
+    void* file;                 // HANDLEs, kept as void* so windows.h stays out of the header
+    void* mapping;
+#endif
+};
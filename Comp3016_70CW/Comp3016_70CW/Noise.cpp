@@ -0,0 +1,77 @@
+#include <cmath>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "main.h"
+#include "Noise.h"
+#include "NoiseKernel.h"
+
+using namespace std;
+
+
+const NoiseTables& GetNoiseTables() {
+    // Built once on first use, static initialisation is thread safe so worker threads can share it
+    static const NoiseTables tables = [] {
+        NoiseTables result;
+        for (int i = 0; i < NOISE_OCTAVES; i++) {
+            // Frequency increases per octave
+            result.frequency[i] = NOISE_BASE_FREQUENCY * (float)pow(2.0f, i);
+
+            // Amplitude decreases per octave
+            result.amplitude[i] = NOISE_BASE_AMPLITUDE * (float)pow(NOISE_PERSISTENCE, i);
+        }
+        return result;
+    }();
+
+    return tables;
+}
+
+// Check the CPU and operating system both support AVX2
+static bool CpuSupportsAvx2() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+
+    // AVX and OS saving of the YMM registers
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+void GenerateHeightRow(float startX, float z, float stepX, int count, float* heights) {
+    static const bool useAvx2 = CpuSupportsAvx2();
+
+    if (useAvx2 && GenerateHeightRowAvx2(startX, z, stepX, count, heights)) {
+        return;
+    }
+
+#if NOISE_HAS_SSE2
+    FbmRow<F4>(startX, z, stepX, count, heights);
+#else
+    for (int i = 0; i < count; i++) {
+        heights[i] = GenerateHeight(startX + i * stepX, z);
+    }
+#endif
+}
+
+void GenerateHeightTile(float startX, float startZ, float step, int countX, int countZ, float* heights) {
+    for (int z = 0; z < countZ; z++) {
+        GenerateHeightRow(startX, startZ + z * step, step, countX, heights + z * countX);
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+
+// Define terrain noise constants
+const float NOISE_BASE_FREQUENCY = 0.02f;   // Higher value = More hills
+const float NOISE_BASE_AMPLITUDE = 25.0f;   // Higher value = Bigger hills
+const float NOISE_PERSISTENCE = 0.35f;      // Amplitude scaling for each octave
+const int NOISE_OCTAVES = 6;                // Higher value = more terrain detail
+const int NOISE_VERSION = 1;                // Bump whenever the height functions change, invalidates cached chunks
+
+// Largest difference between the batched (SIMD) height functions and the scalar GenerateHeight.
+// The batched kernels repeat glm::perlin's arithmetic operation for operation so results are normally
+// bit identical, this bound only covers compilers that reorder or fuse the scalar glm code.
+const float NOISE_BATCH_TOLERANCE = 1e-4f;
+
+
+// Per octave frequency and amplitude, computed once instead of calling pow() for every sample
+struct NoiseTables {
+    float frequency[NOISE_OCTAVES];
+    float amplitude[NOISE_OCTAVES];
+};
+
+// Get the shared octave tables
+const NoiseTables& GetNoiseTables();
+
+// Function to generate heights for a row of samples at (startX + i * stepX, z), i = 0..count-1.
+// Uses AVX2 when the CPU supports it, otherwise SSE2, otherwise falls back to GenerateHeight.
+void GenerateHeightRow(float startX, float z, float stepX, int count, float* heights);
+
+// Function to generate heights for a countX * countZ tile of samples, stored row by row (x fastest)
+void GenerateHeightTile(float startX, float startZ, float step, int countX, int countZ, float* heights);
@@ -0,0 +1,13 @@
+// Built with /arch:AVX2 (see the project file), only called once Noise.cpp has checked the CPU supports it
+#include "NoiseKernel.h"
+
+
+bool GenerateHeightRowAvx2(float startX, float z, float stepX, int count, float* heights) {
+#if NOISE_HAS_AVX2
+    FbmRow<F8>(startX, z, stepX, count, heights);
+    return true;
+#else
+    (void)startX; (void)z; (void)stepX; (void)count; (void)heights;
+    return false;
+#endif
+}
@@ -0,0 +1,177 @@
+#pragma once
+// Batched Perlin/fBm kernel shared by Noise.cpp (SSE2) and NoiseAvx2.cpp (AVX2).
+// Everything lives in an anonymous namespace so each file keeps its own copy compiled for its
+// own instruction set, sharing one definition between them would let the linker pick the AVX2 copy for SSE2 callers.
+
+#include "Noise.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NOISE_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define NOISE_HAS_SSE2 0
+#endif
+
+#if defined(__AVX2__)
+#define NOISE_HAS_AVX2 1
+#include <immintrin.h>
+#else
+#define NOISE_HAS_AVX2 0
+#endif
+
+
+// Function to generate a row of heights with 8 wide AVX2, returns false if this build has no AVX2 kernel
+bool GenerateHeightRowAvx2(float startX, float z, float stepX, int count, float* heights);
+
+
+namespace {
+
+#if NOISE_HAS_SSE2
+    // 4 floats in one SSE register
+    struct F4 {
+        static const int Width = 4;
+        __m128 v;
+
+        F4(__m128 value) : v(value) {}
+        explicit F4(float value) : v(_mm_set1_ps(value)) {}
+
+        static F4 Ramp() { return _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f); }
+        void Store(float* out) const { _mm_storeu_ps(out, v); }
+    };
+
+    inline F4 operator+(F4 a, F4 b) { return _mm_add_ps(a.v, b.v); }
+    inline F4 operator-(F4 a, F4 b) { return _mm_sub_ps(a.v, b.v); }
+    inline F4 operator*(F4 a, F4 b) { return _mm_mul_ps(a.v, b.v); }
+    inline F4 operator/(F4 a, F4 b) { return _mm_div_ps(a.v, b.v); }
+    inline F4 Abs(F4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+
+    // SSE2 has no floor instruction, truncate then step down where truncation rounded up (valid for |a| < 2^31)
+    inline F4 Floor(F4 a) {
+        __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+        __m128 adjust = _mm_and_ps(_mm_cmpgt_ps(truncated, a.v), _mm_set1_ps(1.0f));
+        return _mm_sub_ps(truncated, adjust);
+    }
+#endif
+
+#if NOISE_HAS_AVX2
+    // 8 floats in one AVX register
+    struct F8 {
+        static const int Width = 8;
+        __m256 v;
+
+        F8(__m256 value) : v(value) {}
+        explicit F8(float value) : v(_mm256_set1_ps(value)) {}
+
+        static F8 Ramp() { return _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f); }
+        void Store(float* out) const { _mm256_storeu_ps(out, v); }
+    };
+
+    inline F8 operator+(F8 a, F8 b) { return _mm256_add_ps(a.v, b.v); }
+    inline F8 operator-(F8 a, F8 b) { return _mm256_sub_ps(a.v, b.v); }
+    inline F8 operator*(F8 a, F8 b) { return _mm256_mul_ps(a.v, b.v); }
+    inline F8 operator/(F8 a, F8 b) { return _mm256_div_ps(a.v, b.v); }
+    inline F8 Abs(F8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+    inline F8 Floor(F8 a) { return _mm256_floor_ps(a.v); }
+#endif
+
+    // glm::mod (x - y * floor(x / y))
+    template<typename F>
+    inline F Mod(F x, F y) {
+        return x - y * Floor(x / y);
+    }
+
+    // glm::detail::permute, hashes lattice coordinates in the range 0..288
+    template<typename F>
+    inline F Permute(F x) {
+        F scaled = (x * F(34.0f) + F(1.0f)) * x;
+        return scaled - Floor(scaled * F(1.0f / 289.0f)) * F(289.0f);
+    }
+
+    // Gradient at a hashed lattice corner dotted with the offset to that corner
+    template<typename F>
+    inline F GradientDot(F hash, F offsetX, F offsetY) {
+        F gx = F(2.0f) * (hash / F(41.0f) - Floor(hash / F(41.0f))) - F(1.0f);
+        F gy = Abs(gx) - F(0.5f);
+        gx = gx - Floor(gx + F(0.5f));
+
+        // glm::detail::taylorInvSqrt
+        F norm = F((float)1.79284291400159) - F((float)0.85373472095314) * (gx * gx + gy * gy);
+
+        return (gx * norm) * offsetX + (gy * norm) * offsetY;
+    }
+
+    // glm::mix
+    template<typename F>
+    inline F Mix(F a, F b, F t) {
+        return a * (F(1.0f) - t) + b * t;
+    }
+
+    // glm::detail::fade
+    template<typename F>
+    inline F Fade(F t) {
+        return (t * t * t) * (t * (t * F(6.0f) - F(15.0f)) + F(10.0f));
+    }
+
+    // Classic Perlin noise, same steps as glm::perlin(vec2) one lane per sample
+    template<typename F>
+    inline F Perlin(F x, F y) {
+        F floorX = Floor(x);
+        F floorY = Floor(y);
+
+        // Lattice cell corners, wrapped to avoid truncation in the permutation
+        F x0 = Mod(floorX, F(289.0f));
+        F y0 = Mod(floorY, F(289.0f));
+        F x1 = Mod(floorX + F(1.0f), F(289.0f));
+        F y1 = Mod(floorY + F(1.0f), F(289.0f));
+
+        // Offsets from each corner
+        F fx0 = x - floorX;
+        F fy0 = y - floorY;
+        F fx1 = fx0 - F(1.0f);
+        F fy1 = fy0 - F(1.0f);
+
+        F px0 = Permute(x0);
+        F px1 = Permute(x1);
+
+        F n00 = GradientDot(Permute(px0 + y0), fx0, fy0);
+        F n10 = GradientDot(Permute(px1 + y0), fx1, fy0);
+        F n01 = GradientDot(Permute(px0 + y1), fx0, fy1);
+        F n11 = GradientDot(Permute(px1 + y1), fx1, fy1);
+
+        F fadeX = Fade(fx0);
+        F fadeY = Fade(fy0);
+
+        return F((float)2.3) * Mix(Mix(n00, n10, fadeX), Mix(n01, n11, fadeX), fadeY);
+    }
+
+    // Fractal sum of octaves for a row of samples, F::Width samples at a time
+    template<typename F>
+    inline void FbmRow(float startX, float z, float stepX, int count, float* heights) {
+        const NoiseTables& tables = GetNoiseTables();
+
+        for (int i = 0; i < count; i += F::Width) {
+            // Sample positions match GenerateHeight callers computing offset + index * step
+            F x = (F((float)i) + F::Ramp()) * F(stepX) + F(startX);
+            F zv(z);
+
+            F height(0.0f);
+            for (int octave = 0; octave < NOISE_OCTAVES; octave++) {
+                F frequency(tables.frequency[octave]);
+                height = height + Perlin(x * frequency, zv * frequency) * F(tables.amplitude[octave]);
+            }
+
+            if (count - i >= F::Width) {
+                height.Store(heights + i);
+            }
+            else {
+                // Partial batch at the end of the row
+                float tail[F::Width];
+                height.Store(tail);
+                for (int lane = 0; lane < count - i; lane++) {
+                    heights[i + lane] = tail[lane];
+                }
+            }
+        }
+    }
+
+}
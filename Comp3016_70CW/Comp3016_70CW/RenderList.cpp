@@ -0,0 +1,71 @@
+#include <algorithm>
+
+#include "RenderList.h"
+#include "main.h"
+
+using namespace std;
+
+
+void RenderList::Clear() {
+    slot.clear();
+    terrainDistance.clear();
+    waterDistance.clear();
+    terrainTest.clear();
+    terrainOrigin.clear();
+    terrainModel.clear();
+    terrainLod.clear();
+    terrainBaseVertex.clear();
+    terrainHeightmapLayer.clear();
+    terrainSkirtDepth.clear();
+    terrainHeights.clear();
+    waterVertexArray.clear();
+    waterTexture.clear();
+    waterBaseVertex.clear();
+    waterIndexCount.clear();
+    waterDataOffset.clear();
+    terrainOrder.clear();
+    waterOrder.clear();
+}
+
+void RenderList::Add(TerrainChunk& newChunk, float newTerrainDistance, float newWaterDistance, FrustumTest newTerrainTest, FrustumTest waterTest) {
+    int record = Size();
+    slot.push_back(newChunk.slot);
+    terrainDistance.push_back(newTerrainDistance);
+    waterDistance.push_back(newWaterDistance);
+    terrainTest.push_back(newTerrainTest);
+
+    const RenderTerrainObject& terrain = newChunk.terrain;
+    terrainOrigin.push_back(vec2(newChunk.chunkX * CHUNK_WORLD_SIZE, newChunk.chunkZ * CHUNK_WORLD_SIZE));
+    terrainModel.push_back(terrain.modelMatrix);
+    terrainLod.push_back(terrain.lod);
+    terrainBaseVertex.push_back(std::max(terrain.baseVertex, 0));
+    terrainHeightmapLayer.push_back(terrain.heightmapLayer);
+    terrainSkirtDepth.push_back(terrain.skirtDepth);
+    terrainHeights.push_back(newChunk.heightfield.get());
+
+    const RenderWaterObject& water = newChunk.water;
+    waterVertexArray.push_back(water.VAO);
+    waterTexture.push_back(water.texture);
+    waterBaseVertex.push_back(water.baseVertex);
+    waterIndexCount.push_back((GLsizei)water.indexCount);
+    waterDataOffset.push_back(water.dataOffset);
+
+    if (newTerrainTest != FRUSTUM_OUTSIDE) {
+        terrainOrder.push_back(record);
+    }
+    if (waterTest != FRUSTUM_OUTSIDE) {
+        waterOrder.push_back(record);
+    }
+}
+
+void RenderList::Sort() {
+    // Stable, chunks at the same distance keep the grid's order from frame to frame
+    const vector<float>& terrainDistances = terrainDistance;
+    stable_sort(terrainOrder.begin(), terrainOrder.end(), [&terrainDistances](int a, int b) {
+        return terrainDistances[a] < terrainDistances[b];
+    });
+    const vector<float>& waterDistances = waterDistance;
+    stable_sort(waterOrder.begin(), waterOrder.end(), [&waterDistances](int a, int b) {
+        return waterDistances[a] > waterDistances[b];
+    });
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <GL/glew.h>
+#include <glm/glm/ext/matrix_float4x4.hpp>
+#include <glm/glm/ext/vector_float2.hpp>
+
+#include "Frustum.h"
+
+using namespace std;
+using namespace glm;
+
+struct TerrainChunk;
+struct ChunkHeightfield;
+
+
+// Visible chunks of one frame, built once after culling and read by both the terrain and the water pass. Every field is
+// its own array indexed by record, like BoxList, so the passes walk packed draw state instead of the TerrainChunk structs.
+// The draw orders are separate index arrays, sorting them never moves the records.
+struct RenderList {
+    // Per record
+    vector<int> slot;                   // Chunk slot, for the GPU culling pass
+    vector<float> terrainDistance;      // Squared, from the camera to the closest point of the chunk's terrain box
+    vector<float> waterDistance;        // Squared, from the camera to the closest point of the chunk's water plane
+    vector<FrustumTest> terrainTest;    // Result of the chunk's terrain box, sub-patches are tested by the terrain pass
+
+    // Terrain draw state for CPU culling, with GPU culling the LOD level and skirt depth are picked by the culling pass
+    vector<vec2> terrainOrigin;         // World x and z of the chunk's corner
+    vector<mat4> terrainModel;
+    vector<int> terrainLod;
+    vector<GLint> terrainBaseVertex;    // Into the shared terrain vertex buffer, 0 in heightmap mode
+    vector<int> terrainHeightmapLayer;
+    vector<float> terrainSkirtDepth;
+    vector<const ChunkHeightfield*> terrainHeights;     // For the sub-patch height ranges
+
+    vector<GLuint> waterVertexArray;
+    vector<GLuint> waterTexture;
+    vector<GLint> waterBaseVertex;
+    vector<GLsizei> waterIndexCount;
+    vector<GLintptr> waterDataOffset;   // Of the chunk's WaterChunkData in the water chunk uniform buffer
+
+    // Records in the order they are drawn, set by Sort
+    vector<int> terrainOrder;
+    vector<int> waterOrder;
+
+    void Clear();
+
+    // Add a chunk whose terrain or water box is at least partly inside the frustum
+    void Add(TerrainChunk& chunk, float terrainDistance, float waterDistance, FrustumTest terrainTest, FrustumTest waterTest);
+
+    // Terrain nearest first, so the depth test rejects as many terrain fragments as it can before they are shaded.
+    // Water furthest first, so each translucent quad blends over the water behind it
+    void Sort();
+
+    int Size() const { return (int)slot.size(); }
+};
@@ -0,0 +1,134 @@
+#include <vector>
+#include <glm/glm/gtc/type_ptr.hpp>
+
+#include "ShaderProgram.h"
+
+using namespace std;
+
+
+ShaderProgram::ShaderProgram() : id(0) {}
+
+bool ShaderProgram::Load(ShaderInfo* shaders) {
+    Destroy();
+
+    id = LoadShaders(shaders);
+    if (id == 0) {
+        return false;
+    }
+
+    Reflect();
+    return true;
+}
+
+void ShaderProgram::Destroy() {
+    if (id != 0) {
+        glDeleteProgram(id);
+        id = 0;
+    }
+
+    uniformLocations.clear();
+    uniformBlockSizes.clear();
+    storageBlockSizes.clear();
+}
+
+void ShaderProgram::Use() const {
+    glUseProgram(id);
+}
+
+void ShaderProgram::Reflect() {
+    vector<GLchar> name;
+
+    // Uniforms, block members have no location and are skipped
+    GLint uniformCount = 0;
+    glGetProgramInterfaceiv(id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &uniformCount);
+
+    GLint maxNameLength = 0;
+    glGetProgramInterfaceiv(id, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+    name.resize(maxNameLength + 1);
+
+    for (GLint i = 0; i < uniformCount; i++) {
+        const GLenum properties[] = { GL_LOCATION };
+        GLint location = -1;
+        glGetProgramResourceiv(id, GL_UNIFORM, i, 1, properties, 1, nullptr, &location);
+        if (location < 0) {
+            continue;
+        }
+
+        glGetProgramResourceName(id, GL_UNIFORM, i, (GLsizei)name.size(), nullptr, name.data());
+        string uniformName = name.data();
+
+        // Arrays are reported as their first element
+        if (uniformName.size() > 3 && uniformName.compare(uniformName.size() - 3, 3, "[0]") == 0) {
+            uniformName.resize(uniformName.size() - 3);
+        }
+        uniformLocations[uniformName] = location;
+    }
+
+    // Uniform and shader storage blocks
+    const GLenum interfaces[] = { GL_UNIFORM_BLOCK, GL_SHADER_STORAGE_BLOCK };
+    unordered_map<string, GLint>* blockSizes[] = { &uniformBlockSizes, &storageBlockSizes };
+
+    for (int j = 0; j < 2; j++) {
+        GLint blockCount = 0;
+        glGetProgramInterfaceiv(id, interfaces[j], GL_ACTIVE_RESOURCES, &blockCount);
+
+        maxNameLength = 0;
+        glGetProgramInterfaceiv(id, interfaces[j], GL_MAX_NAME_LENGTH, &maxNameLength);
+        name.resize(maxNameLength + 1);
+
+        for (GLint i = 0; i < blockCount; i++) {
+            const GLenum properties[] = { GL_BUFFER_DATA_SIZE };
+            GLint size = 0;
+            glGetProgramResourceiv(id, interfaces[j], i, 1, properties, 1, nullptr, &size);
+
+            glGetProgramResourceName(id, interfaces[j], i, (GLsizei)name.size(), nullptr, name.data());
+            (*blockSizes[j])[name.data()] = size;
+        }
+    }
+}
+
+GLint ShaderProgram::GetUniformLocation(const string& name) const {
+    unordered_map<string, GLint>::const_iterator uniform = uniformLocations.find(name);
+    return uniform != uniformLocations.end() ? uniform->second : -1;
+}
+
+GLint ShaderProgram::GetBlockSize(const unordered_map<string, GLint>& blocks, const string& name) const {
+    unordered_map<string, GLint>::const_iterator block = blocks.find(name);
+    return block != blocks.end() ? block->second : -1;
+}
+
+GLint ShaderProgram::GetUniformBlockSize(const string& name) const {
+    return GetBlockSize(uniformBlockSizes, name);
+}
+
+GLint ShaderProgram::GetStorageBlockSize(const string& name) const {
+    return GetBlockSize(storageBlockSizes, name);
+}
+
+void ShaderProgram::SetUniform(const string& name, int value) const {
+    glProgramUniform1i(id, GetUniformLocation(name), value);
+}
+
+void ShaderProgram::SetUniform(const string& name, unsigned int value) const {
+    glProgramUniform1ui(id, GetUniformLocation(name), value);
+}
+
+void ShaderProgram::SetUniform(const string& name, float value) const {
+    glProgramUniform1f(id, GetUniformLocation(name), value);
+}
+
+void ShaderProgram::SetUniform(const string& name, const vec2& value) const {
+    glProgramUniform2fv(id, GetUniformLocation(name), 1, value_ptr(value));
+}
+
+void ShaderProgram::SetUniform(const string& name, const vec3& value) const {
+    glProgramUniform3fv(id, GetUniformLocation(name), 1, value_ptr(value));
+}
+
+void ShaderProgram::SetUniform(const string& name, const vec4* values, int count) const {
+    glProgramUniform4fv(id, GetUniformLocation(name), count, value_ptr(values[0]));
+}
+
+void ShaderProgram::SetUniform(const string& name, const mat4& value) const {
+    glProgramUniformMatrix4fv(id, GetUniformLocation(name), 1, GL_FALSE, value_ptr(value));
+}
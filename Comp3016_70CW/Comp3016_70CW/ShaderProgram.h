@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <GL/glew.h>
+#include <glm/glm/glm.hpp>
+
+#include "LoadShaders.h"
+
+using namespace std;
+using namespace glm;
+
+
+// Linked shader program with its active uniforms and blocks reflected once at link time, so setting a uniform is a
+// hash lookup instead of a glGetUniformLocation call. Uniforms are set with glProgramUniform*, the program does not
+// have to be in use. Names the program does not have (misspelt or optimised out) are ignored, like location -1 is.
+class ShaderProgram {
+public:
+    ShaderProgram();
+
+    // Compile and link the shaders with LoadShaders, then reflect the program. False if it failed to link
+    bool Load(ShaderInfo* shaders);
+
+    // Delete the program
+    void Destroy();
+
+    void Use() const;
+
+    // Location of an active uniform outside any block, array uniforms by their name without [0]. -1 if there is none
+    GLint GetUniformLocation(const string& name) const;
+
+    // Size in bytes of an active uniform or shader storage block, -1 if there is none
+    GLint GetUniformBlockSize(const string& name) const;
+    GLint GetStorageBlockSize(const string& name) const;
+
+    // Set uniforms outside any block
+    void SetUniform(const string& name, int value) const;
+    void SetUniform(const string& name, unsigned int value) const;
+    void SetUniform(const string& name, float value) const;
+    void SetUniform(const string& name, const vec2& value) const;
+    void SetUniform(const string& name, const vec3& value) const;
+    void SetUniform(const string& name, const vec4* values, int count) const;
+    void SetUniform(const string& name, const mat4& value) const;
+
+    // Getters
+    GLuint GetId() const { return id; }
+    bool IsLoaded() const { return id != 0; }
+
+private:
+    void Reflect();
+    GLint GetBlockSize(const unordered_map<string, GLint>& blocks, const string& name) const;
+
+    GLuint id;
+    unordered_map<string, GLint> uniformLocations;
+    unordered_map<string, GLint> uniformBlockSizes;
+    unordered_map<string, GLint> storageBlockSizes;
+};
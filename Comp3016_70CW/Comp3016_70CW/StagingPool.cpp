@@ -0,0 +1,100 @@
+#include "StagingPool.h"
+
+using namespace std;
+
+
+// Slot offsets are kept aligned for 16 byte non-temporal stores of vertex data
+const GLsizeiptr STAGING_SLOT_ALIGNMENT = 64;
+
+
+StagingPool::StagingPool() :
+    buffer(0),
+    mapped(nullptr),
+    slotSize(0),
+    slotCount(0)
+{}
+
+void StagingPool::Create(GLsizeiptr size, int count) {
+    if (buffer) {
+        return;
+    }
+
+    size = (size + STAGING_SLOT_ALIGNMENT - 1) / STAGING_SLOT_ALIGNMENT * STAGING_SLOT_ALIGNMENT;
+
+    // Mapped for as long as the buffer lives, coherent so writes from any thread need no explicit flush
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glBufferStorage(GL_COPY_READ_BUFFER, size * count, nullptr, flags);
+    mapped = (char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, size * count, flags);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    slotSize = size;
+    slotCount = count;
+}
+
+void StagingPool::Destroy() {
+    for (const Batch& batch : batches) {
+        glDeleteSync(batch.fence);
+    }
+    batches.clear();
+    unfenced.clear();
+
+    if (buffer) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    buffer = 0;
+    mapped = nullptr;
+    slotSize = 0;
+    slotCount = 0;
+}
+
+StagingAllocation StagingPool::GetSlot(int slot) const {
+    StagingAllocation allocation;
+    if (!mapped || slot < 0 || slot >= slotCount) {
+        return allocation;
+    }
+
+    allocation.data = mapped + slot * slotSize;
+    allocation.buffer = buffer;
+    allocation.offset = slot * slotSize;
+    return allocation;
+}
+
+void StagingPool::Release(int slot) {
+    unfenced.push_back(slot);
+}
+
+void StagingPool::Fence() {
+    if (unfenced.empty()) {
+        return;
+    }
+
+    Batch batch;
+    batch.slots.swap(unfenced);
+    batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    batches.push_back(move(batch));
+}
+
+vector<int> StagingPool::Reclaim() {
+    vector<int> reclaimed;
+
+    while (!batches.empty()) {
+        // Flushing makes sure the fence reaches the GPU even when nothing else flushes (e.g. while loading)
+        GLenum status = glClientWaitSync(batches.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+
+        glDeleteSync(batches.front().fence);
+        reclaimed.insert(reclaimed.end(), batches.front().slots.begin(), batches.front().slots.end());
+        batches.pop_front();
+    }
+
+    return reclaimed;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <deque>
+#include <vector>
+#include <GL/glew.h>
+
+#include "StagingRing.h"
+
+using namespace std;
+
+
+// Persistently mapped upload buffer split into equal slots. Unlike the staging ring a slot can be held for as long
+// as it takes to fill, so the GL thread can hand slots out in advance to worker threads which write straight into
+// the mapping. A slot released after its copy is issued is only reused once the fence after that copy signals.
+class StagingPool {
+public:
+    StagingPool();
+
+    // Create and map the buffer, must be called on the GL thread
+    void Create(GLsizeiptr slotSize, int slotCount);
+
+    // Unmap and delete the buffer, must be called while the GL context still exists
+    void Destroy();
+
+    // Where a slot's data is written and copied from
+    StagingAllocation GetSlot(int slot) const;
+
+    // Release a slot read by GPU commands, it is returned by Reclaim once the next fence signals
+    void Release(int slot);
+
+    // Fence every slot released since the last call, call after issuing the copies that read them
+    void Fence();
+
+    // Slots whose fences have signalled, free to be filled again
+    vector<int> Reclaim();
+
+    // Getters
+    int GetSlotCount() const { return slotCount; }
+    GLsizeiptr GetSlotSize() const { return slotSize; }
+
+private:
+    struct Batch {
+        vector<int> slots;
+        GLsync fence;
+    };
+
+    GLuint buffer;
+    char* mapped;
+    GLsizeiptr slotSize;
+    int slotCount;
+    vector<int> unfenced;       // Released since the last fence
+    deque<Batch> batches;       // Oldest first
+};
@@ -0,0 +1,113 @@
+#include "StagingRing.h"
+
+using namespace std;
+
+
+// Offsets are kept aligned for any vertex or pixel type read from the ring
+const GLintptr STAGING_ALIGNMENT = 16;
+
+
+StagingRing::StagingRing() :
+    buffer(0),
+    mapped(nullptr),
+    size(0),
+    head(0),
+    used(0),
+    unfenced(0)
+{}
+
+void StagingRing::Create(GLsizeiptr ringSize) {
+    if (buffer) {
+        return;
+    }
+
+    // Mapped for as long as the buffer lives, coherent so writes need no explicit flush before the copies read them
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glBufferStorage(GL_COPY_READ_BUFFER, ringSize, nullptr, flags);
+    mapped = (char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, ringSize, flags);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+    size = ringSize;
+    head = 0;
+    used = 0;
+    unfenced = 0;
+}
+
+void StagingRing::Destroy() {
+    for (const Batch& batch : batches) {
+        glDeleteSync(batch.fence);
+    }
+    batches.clear();
+
+    if (buffer) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_READ_BUFFER);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+    }
+
+    buffer = 0;
+    mapped = nullptr;
+    size = 0;
+    head = 0;
+    used = 0;
+    unfenced = 0;
+}
+
+StagingAllocation StagingRing::Allocate(GLsizeiptr bytes) {
+    StagingAllocation allocation;
+    if (!mapped) {
+        return allocation;
+    }
+
+    Reclaim();
+
+    // Data in use is one contiguous run behind head, so everything from head up to the start of that run is free.
+    // Skip to the start of the buffer when the allocation would run off the end.
+    GLintptr offset = (head + STAGING_ALIGNMENT - 1) / STAGING_ALIGNMENT * STAGING_ALIGNMENT;
+    if (offset + bytes > size) {
+        offset = 0;
+    }
+    GLsizeiptr padding = (offset >= head ? offset - head : size - head + offset);
+    if (padding + bytes > size - used) {
+        return allocation;
+    }
+
+    head = offset + bytes;
+    used += padding + bytes;
+    unfenced += padding + bytes;
+
+    allocation.data = mapped + offset;
+    allocation.buffer = buffer;
+    allocation.offset = offset;
+    return allocation;
+}
+
+void StagingRing::Fence() {
+    if (unfenced == 0) {
+        return;
+    }
+
+    Batch batch;
+    batch.bytes = unfenced;
+    batch.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    batches.push_back(batch);
+    unfenced = 0;
+}
+
+void StagingRing::Reclaim() {
+    while (!batches.empty()) {
+        // Flushing makes sure the fence reaches the GPU even when nothing else flushes (e.g. while loading)
+        GLenum status = glClientWaitSync(batches.front().fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            break;
+        }
+
+        glDeleteSync(batches.front().fence);
+        used -= batches.front().bytes;
+        batches.pop_front();
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <deque>
+#include <GL/glew.h>
+
+using namespace std;
+
+
+// Space handed out by the staging ring, write the data to upload at data then copy it on the GPU from buffer at offset
+struct StagingAllocation {
+    void* data;                 // Null when the ring had no room
+    GLuint buffer;
+    GLintptr offset;
+
+    StagingAllocation() : data(nullptr), buffer(0), offset(0) {}
+};
+
+
+// Persistently mapped upload buffer used as a ring. Data is written straight into the mapping and copied into its
+// destination buffer or texture by the GPU, so uploads never wait on the driver. Each batch of allocations is fenced
+// once its copies are issued, and its space is only reused after the fence signals, keeping memory use bounded.
+class StagingRing {
+public:
+    StagingRing();
+
+    // Create and map the buffer, must be called on the GL thread
+    void Create(GLsizeiptr size);
+
+    // Unmap and delete the buffer, must be called while the GL context still exists
+    void Destroy();
+
+    // Space for size bytes, data is null when the ring is full of data the GPU has not finished copying yet
+    StagingAllocation Allocate(GLsizeiptr size);
+
+    // Fence every allocation since the last call, call after issuing the copies that read them
+    void Fence();
+
+    // Getters
+    GLsizeiptr GetSize() const { return size; }
+    GLsizeiptr GetUsed() const { return used; }
+
+private:
+    // Release batches whose fences have signalled
+    void Reclaim();
+
+    struct Batch {
+        GLsizeiptr bytes;       // Including any alignment or wrap padding
+        GLsync fence;
+    };
+
+    GLuint buffer;
+    char* mapped;
+    GLsizeiptr size;
+    GLintptr head;              // Next byte to hand out, data in use runs from behind it for used bytes
+    GLsizeiptr used;
+    GLsizeiptr unfenced;        // Bytes handed out since the last fence
+    deque<Batch> batches;       // Oldest first
+};
@@ -0,0 +1,418 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TERRAIN_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define TERRAIN_HAS_SSE2 0
+#endif
+
+#include <glm/glm/gtc/noise.hpp>
+
+#include "main.h"
+#include "Noise.h"
+
+using namespace std;
+using namespace glm;
+
+
+float GenerateHeight(float x, float z) {
+    const NoiseTables& tables = GetNoiseTables();
+
+    float height = 0.0f;        // Accumlated height
+
+    for (int i = 0; i < NOISE_OCTAVES; i++) {
+        float frequency = tables.frequency[i];
+        float amplitude = tables.amplitude[i];
+
+        // Use glm to generate perlin noise and multiply by amplitude
+        height += perlin(vec2(x * frequency, z * frequency)) * amplitude;
+    }
+
+    return height;
+}
+
+shared_ptr<ChunkHeightfield> BuildHeightfield(int chunkX, int chunkZ, const ChunkNeighbours& neighbours) {
+    shared_ptr<ChunkHeightfield> field = make_shared<ChunkHeightfield>();
+    field->chunkX = chunkX;
+    field->chunkZ = chunkZ;
+    field->heights.resize(HEIGHTFIELD_SIZE * HEIGHTFIELD_SIZE);
+
+    float* heights = field->heights.data();
+    const int size = HEIGHTFIELD_SIZE;
+
+    // Adjacent grids overlap by three samples (a neighbour's last vertex row and apron are our apron and first two rows),
+    // the same sample sits CHUNK_SIZE entries further along in the neighbour before us and CHUNK_SIZE earlier in the one after
+    const int overlap = 3;
+
+    // Copy rows shared with the chunks below and above
+    if (neighbours.down) {
+        for (int row = 0; row < overlap; row++) {
+            copy_n(&neighbours.down->heights[(row + CHUNK_SIZE) * size], size, heights + row * size);
+        }
+    }
+    if (neighbours.up) {
+        for (int row = size - overlap; row < size; row++) {
+            copy_n(&neighbours.up->heights[(row - CHUNK_SIZE) * size], size, heights + row * size);
+        }
+    }
+
+    // Copy columns shared with the chunks to the left and right
+    for (int row = 0; row < size; row++) {
+        for (int column = 0; column < overlap; column++) {
+            if (neighbours.left) {
+                heights[row * size + column] = neighbours.left->heights[row * size + column + CHUNK_SIZE];
+            }
+            if (neighbours.right) {
+                int rightColumn = size - overlap + column;
+                heights[row * size + rightColumn] = neighbours.right->heights[row * size + rightColumn - CHUNK_SIZE];
+            }
+        }
+    }
+
+    // Generate everything not copied, the sample positions are exact in float so copied and generated values are identical
+    int firstRow = neighbours.down ? overlap : 0;
+    int endRow = neighbours.up ? size - overlap : size;
+    int firstColumn = neighbours.left ? overlap : 0;
+    int endColumn = neighbours.right ? size - overlap : size;
+
+    float offsetX = chunkX * CHUNK_WORLD_SIZE;
+    float offsetZ = chunkZ * CHUNK_WORLD_SIZE;
+
+    for (int row = firstRow; row < endRow; row++) {
+        float worldZ = offsetZ + (row - 1) * TILE_SIZE;
+        float startX = offsetX + (firstColumn - 1) * TILE_SIZE;
+
+        GenerateHeightRow(startX, worldZ, TILE_SIZE, endColumn - firstColumn, heights + row * size + firstColumn);
+    }
+
+    MeasureHeightfield(*field);
+    return field;
+}
+
+void MeasureHeightfield(ChunkHeightfield& field) {
+    // Height range of the chunk itself
+    field.minHeight = field.maxHeight = field.At(0, 0);
+    for (int z = 0; z <= CHUNK_SIZE; z++) {
+        for (int x = 0; x <= CHUNK_SIZE; x++) {
+            field.minHeight = std::min(field.minHeight, field.At(x, z));
+            field.maxHeight = std::max(field.maxHeight, field.At(x, z));
+        }
+    }
+
+    // Error of each LOD level, used to pick levels and skirt depths at render time
+    for (int level = 0; level < TERRAIN_LOD_LEVELS; level++) {
+        field.lodError[level] = MeasureLodError(field, TERRAIN_LOD_STRIDES[level]);
+    }
+
+    // Bounds of the culling sub-patches
+    MeasurePatchHeights(field);
+}
+
+void GetTerrainPatchExtent(int gridWidth, int gridDepth, int stride, int node, int& x0, int& z0, int& x1, int& z1) {
+    // Depth of the node and its position (Morton code) among the nodes at that depth
+    int depth = 0;
+    int depthStart = 0;
+    while (node >= depthStart + (1 << (2 * depth))) {
+        depthStart += 1 << (2 * depth);
+        depth++;
+    }
+    int morton = node - depthStart;
+
+    // Even bits of the Morton code give the x position, odd bits the z position
+    int px = 0;
+    int pz = 0;
+    for (int bit = 0; bit < depth; bit++) {
+        px |= ((morton >> (2 * bit)) & 1) << bit;
+        pz |= ((morton >> (2 * bit + 1)) & 1) << bit;
+    }
+
+    // Split the level's coarse cells as evenly as possible, parent and child edges always line up
+    int parts = 1 << depth;
+    int cellsX = gridWidth / stride;
+    int cellsZ = gridDepth / stride;
+    x0 = px * cellsX / parts * stride;
+    x1 = (px + 1) * cellsX / parts * stride;
+    z0 = pz * cellsZ / parts * stride;
+    z1 = (pz + 1) * cellsZ / parts * stride;
+}
+
+void MeasurePatchHeights(ChunkHeightfield& field) {
+    const int leafCount = 1 << (2 * TERRAIN_PATCH_DEPTH);
+    const int firstLeaf = TERRAIN_PATCH_NODES - leafCount;
+
+    for (int level = 0; level < TERRAIN_LOD_LEVELS; level++) {
+        float* minHeights = field.patchMinHeight[level];
+        float* maxHeights = field.patchMaxHeight[level];
+
+        // Leaves from their vertices, empty leaves get an inverted range so they never widen a parent
+        for (int leaf = firstLeaf; leaf < TERRAIN_PATCH_NODES; leaf++) {
+            int x0, z0, x1, z1;
+            GetTerrainPatchExtent(CHUNK_SIZE, CHUNK_SIZE, TERRAIN_LOD_STRIDES[level], leaf, x0, z0, x1, z1);
+
+            minHeights[leaf] = numeric_limits<float>::max();
+            maxHeights[leaf] = -numeric_limits<float>::max();
+            if (x0 == x1 || z0 == z1) {
+                continue;
+            }
+
+            for (int z = z0; z <= z1; z++) {
+                for (int x = x0; x <= x1; x++) {
+                    minHeights[leaf] = std::min(minHeights[leaf], field.At(x, z));
+                    maxHeights[leaf] = std::max(maxHeights[leaf], field.At(x, z));
+                }
+            }
+        }
+
+        // Parents from their children
+        for (int node = firstLeaf - 1; node >= 0; node--) {
+            minHeights[node] = numeric_limits<float>::max();
+            maxHeights[node] = -numeric_limits<float>::max();
+            for (int child = 4 * node + 1; child <= 4 * node + 4; child++) {
+                minHeights[node] = std::min(minHeights[node], minHeights[child]);
+                maxHeights[node] = std::max(maxHeights[node], maxHeights[child]);
+            }
+        }
+    }
+}
+
+float MeasureLodError(const ChunkHeightfield& field, int stride) {
+    float error = 0.0f;
+
+    for (int z = 0; z <= CHUNK_SIZE; z++) {
+        for (int x = 0; x <= CHUNK_SIZE; x++) {
+            // Corners of the coarse quad containing this vertex (clamped so the far edges use the last quad)
+            int left = std::min(x / stride, CHUNK_SIZE / stride - 1) * stride;
+            int top = std::min(z / stride, CHUNK_SIZE / stride - 1) * stride;
+            float u = (float)(x - left) / stride;
+            float v = (float)(z - top) / stride;
+
+            float topLeft = field.At(left, top);
+            float topRight = field.At(left + stride, top);
+            float bottomLeft = field.At(left, top + stride);
+            float bottomRight = field.At(left + stride, top + stride);
+
+            // Interpolate across whichever triangle the vertex falls in, quads are split along topRight to bottomLeft
+            float coarse;
+            if (u + v <= 1.0f) {
+                coarse = topLeft + u * (topRight - topLeft) + v * (bottomLeft - topLeft);
+            }
+            else {
+                coarse = bottomRight + (1.0f - u) * (bottomLeft - bottomRight) + (1.0f - v) * (topRight - bottomRight);
+            }
+
+            error = std::max(error, abs(coarse - field.At(x, z)));
+        }
+    }
+
+    return error;
+}
+
+TerrainMeshData BuildTerrainMesh(const shared_ptr<const ChunkHeightfield>& heightfield, void* vertices) {
+    const ChunkHeightfield& field = *heightfield;
+    const int gridWidth = CHUNK_SIZE;
+    const int gridDepth = CHUNK_SIZE;
+    const float tileSize = TILE_SIZE;
+
+    TerrainMeshData mesh;
+    mesh.chunkX = field.chunkX;
+    mesh.chunkZ = field.chunkZ;
+    mesh.heightfield = heightfield;
+    mesh.vertices = vertices;
+
+    // Heightmap chunks are drawn straight from the heightfield
+    if (TERRAIN_RENDER_MODE == TERRAIN_HEIGHTMAP_TEXTURE || !vertices) {
+        return mesh;
+    }
+
+    float offsetX = field.chunkX * CHUNK_WORLD_SIZE;
+    float offsetZ = field.chunkZ * CHUNK_WORLD_SIZE;
+
+    // Write the vertex of grid point x, z at index. Vertices go straight to (write-combined) upload memory which is
+    // never read back, so they are streamed past the cache and skirts are rebuilt rather than copied.
+    auto writeVertex = [&](int index, int x, int z) {
+        // Central differences on the heightfield, the apron covers the chunk's edge vertices
+        vec3 normal = normalize(vec3(
+            field.At(x - 1, z) - field.At(x + 1, z),
+            2.0f * tileSize,
+            field.At(x, z - 1) - field.At(x, z + 1)
+        ));
+
+        // Compact vertices leave position and texture to the vertex shader
+        if (TERRAIN_RENDER_MODE == TERRAIN_COMPACT_VERTICES) {
+            CompactTerrainVertex vertex = PackTerrainVertex(field.At(x, z), normal);
+            CompactTerrainVertex* destination = (CompactTerrainVertex*)vertices + index;
+#if TERRAIN_HAS_SSE2
+            int bits;
+            memcpy(&bits, &vertex, sizeof(bits));
+            _mm_stream_si32((int*)destination, bits);
+#else
+            *destination = vertex;
+#endif
+            return;
+        }
+
+        float worldX = offsetX + x * tileSize;
+        float worldZ = offsetZ + z * tileSize;
+        float* destination = (float*)vertices + index * 8;
+
+        // Position, normal, texture
+#if TERRAIN_HAS_SSE2
+        _mm_stream_ps(destination, _mm_setr_ps(worldX, field.At(x, z), worldZ, normal.x));
+        _mm_stream_ps(destination + 4, _mm_setr_ps(normal.y, normal.z, worldX, worldZ));
+#else
+        const float vertex[8] = { worldX, field.At(x, z), worldZ, normal.x, normal.y, normal.z, worldX, worldZ };
+        memcpy(destination, vertex, sizeof(vertex));
+#endif
+    };
+
+    // Generate vertices
+    int index = 0;
+    for (int z = 0; z <= gridDepth; z++) {
+        for (int x = 0; x <= gridWidth; x++) {
+            writeVertex(index++, x, z);
+        }
+    }
+
+    // Skirt vertices, copies of each edge in order (z = 0, z = gridDepth, x = 0, x = gridWidth), the vertex shader lowers them
+    for (int edge = 0; edge < 4; edge++) {
+        int length = edge < 2 ? gridWidth : gridDepth;
+        for (int i = 0; i <= length; i++) {
+            int x = edge < 2 ? i : (edge == 2 ? 0 : gridWidth);
+            int z = edge < 2 ? (edge == 0 ? 0 : gridDepth) : i;
+            writeVertex(index++, x, z);
+        }
+    }
+
+#if TERRAIN_HAS_SSE2
+    // Streaming stores are weakly ordered, make them visible before the mesh is handed to the GL thread
+    _mm_sfence();
+#endif
+
+    return mesh;
+}
+
+vector<uint16_t> BuildTerrainIndices(int gridWidth, int gridDepth, int stride, TerrainPatch* patches) {
+    vector<uint16_t> indices;
+
+    auto gridIndex = [&](int x, int z) { return (uint16_t)(z * (gridWidth + 1) + x); };
+    const int gridVertices = (gridWidth + 1) * (gridDepth + 1);
+
+    // Skirt vertex hanging below grid vertex i of the given edge (z = 0, z = gridDepth, x = 0, x = gridWidth)
+    auto skirtIndex = [&](int edge, int i) {
+        int edgeStart = edge < 2 ? edge * (gridWidth + 1) : 2 * (gridWidth + 1) + (edge - 2) * (gridDepth + 1);
+        return (uint16_t)(gridVertices + edgeStart + i);
+    };
+
+    // Two triangles joining a segment of chunk edge to the skirt below it
+    auto addSkirt = [&](uint16_t top0, uint16_t top1, uint16_t bottom0, uint16_t bottom1) {
+        indices.push_back(top0);
+        indices.push_back(bottom0);
+        indices.push_back(top1);
+
+        indices.push_back(top1);
+        indices.push_back(bottom0);
+        indices.push_back(bottom1);
+    };
+
+    // Leaves are the last nodes of the quadtree, in Morton order, so each parent covers a contiguous run of them
+    const int leafCount = 1 << (2 * TERRAIN_PATCH_DEPTH);
+    const int firstLeaf = TERRAIN_PATCH_NODES - leafCount;
+
+    for (int leaf = firstLeaf; leaf < TERRAIN_PATCH_NODES; leaf++) {
+        TerrainPatch& patch = patches[leaf];
+        GetTerrainPatchExtent(gridWidth, gridDepth, stride, leaf, patch.x0, patch.z0, patch.x1, patch.z1);
+        patch.firstIndex = (unsigned int)indices.size();
+
+        // Walk the patch in vertical bands, each row of quads then reuses the vertices loaded by the row before it
+        const int bandWidth = TERRAIN_INDEX_BAND_WIDTH * stride;
+        for (int bandStart = patch.x0; bandStart < patch.x1; bandStart += bandWidth) {
+            int bandEnd = std::min(bandStart + bandWidth, patch.x1);
+
+            // Prime the cache with the band's first row using degenerate (zero area) triangles, otherwise
+            // each top left vertex gets pushed out by the row below before the next row of quads needs it
+            for (int x = bandStart; x <= bandEnd; x += stride) {
+                indices.push_back(gridIndex(x, patch.z0));
+                indices.push_back(gridIndex(x, patch.z0));
+                indices.push_back(gridIndex(x, patch.z0));
+            }
+
+            for (int z = patch.z0; z < patch.z1; z += stride) {
+                for (int x = bandStart; x < bandEnd; x += stride) {
+                    uint16_t topLeft = gridIndex(x, z);
+                    uint16_t topRight = gridIndex(x + stride, z);
+                    uint16_t bottomLeft = gridIndex(x, z + stride);
+                    uint16_t bottomRight = gridIndex(x + stride, z + stride);
+
+                    // first triangle
+                    indices.push_back(topLeft);
+                    indices.push_back(bottomLeft);
+                    indices.push_back(topRight);
+
+                    // second triangle
+                    indices.push_back(topRight);
+                    indices.push_back(bottomLeft);
+                    indices.push_back(bottomRight);
+                }
+            }
+        }
+
+        // Skirts along whichever chunk edges the patch touches
+        if (patch.x0 < patch.x1 && patch.z0 < patch.z1) {
+            for (int x = patch.x0; x < patch.x1; x += stride) {
+                if (patch.z0 == 0) {
+                    addSkirt(gridIndex(x, 0), gridIndex(x + stride, 0), skirtIndex(0, x), skirtIndex(0, x + stride));
+                }
+                if (patch.z1 == gridDepth) {
+                    addSkirt(gridIndex(x, gridDepth), gridIndex(x + stride, gridDepth), skirtIndex(1, x), skirtIndex(1, x + stride));
+                }
+            }
+            for (int z = patch.z0; z < patch.z1; z += stride) {
+                if (patch.x0 == 0) {
+                    addSkirt(gridIndex(0, z), gridIndex(0, z + stride), skirtIndex(2, z), skirtIndex(2, z + stride));
+                }
+                if (patch.x1 == gridWidth) {
+                    addSkirt(gridIndex(gridWidth, z), gridIndex(gridWidth, z + stride), skirtIndex(3, z), skirtIndex(3, z + stride));
+                }
+            }
+        }
+
+        patch.indexCount = (unsigned int)indices.size() - patch.firstIndex;
+    }
+
+    // Parent ranges span their children (nodes are stored as a 4-ary heap, children of n are 4n + 1 to 4n + 4)
+    for (int node = firstLeaf - 1; node >= 0; node--) {
+        TerrainPatch& patch = patches[node];
+        GetTerrainPatchExtent(gridWidth, gridDepth, stride, node, patch.x0, patch.z0, patch.x1, patch.z1);
+
+        patch.firstIndex = patches[4 * node + 1].firstIndex;
+        patch.indexCount = 0;
+        for (int child = 4 * node + 1; child <= 4 * node + 4; child++) {
+            patch.indexCount += patches[child].indexCount;
+        }
+    }
+
+    return indices;
+}
+
+CompactTerrainVertex PackTerrainVertex(float height, const vec3& normal) {
+    CompactTerrainVertex vertex;
+
+    // Quantize height to 16 bits
+    float heightScale = (height - TERRAIN_MIN_HEIGHT) / (TERRAIN_MAX_HEIGHT - TERRAIN_MIN_HEIGHT);
+    vertex.height = (uint16_t)round(clamp(heightScale, 0.0f, 1.0f) * 65535.0f);
+
+    // Project onto the octahedron |x| + |y| + |z| = 1 with y as its axis, folding the lower half over the upper
+    vec3 n = normal / (abs(normal.x) + abs(normal.y) + abs(normal.z));
+    vec2 encoded = vec2(n.x, n.z);
+    if (n.y < 0.0f) {
+        encoded = (1.0f - abs(vec2(n.z, n.x))) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.z >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    // Quantize each component from -1..1 to 8 bits
+    vertex.normal[0] = (uint8_t)round((encoded.x * 0.5f + 0.5f) * 255.0f);
+    vertex.normal[1] = (uint8_t)round((encoded.y * 0.5f + 0.5f) * 255.0f);
+
+    return vertex;
+}
@@ -1,7 +1,12 @@
 #pragma once
 #include <GLFW/glfw3.h>
 #include <glm/glm/ext/matrix_transform.hpp>
+#include <glm/glm/ext/vector_int4.hpp>
 #include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <chrono>
 
 using namespace std;
 using namespace glm;
@@ -12,40 +17,104 @@ const float WATER_LEVEL = -11.0f;
 const int CHUNK_SIZE = 100;
 const float TILE_SIZE = 2.0;
 const float CHUNK_WORLD_SIZE = CHUNK_SIZE * TILE_SIZE;
-const int RENDER_DISTANCE = 1;      // Number of chunks loaded in each direction from the camera
+const int HEIGHTFIELD_SIZE = CHUNK_SIZE + 3;    // Chunk vertices plus a one sample apron on each side, used for normals
 
+// How terrain chunks are stored on the GPU, values match the constants in vertexShader.vert
+enum TerrainRenderMode {
+    TERRAIN_FLOAT_VERTICES = 0,     // 32 byte vertices (position, normal, texture)
+    TERRAIN_COMPACT_VERTICES = 1,   // 4 byte vertices (quantized height, octahedral normal), x/z rebuilt from gl_VertexID
+    TERRAIN_HEIGHTMAP_TEXTURE = 2   // No chunk mesh, heights live in a texture array layer and every chunk is one instance of a shared grid
+};
+const TerrainRenderMode TERRAIN_RENDER_MODE = TERRAIN_COMPACT_VERTICES;
+const float TERRAIN_MIN_HEIGHT = -64.0f;    // Quantization range for compact vertex heights
+const float TERRAIN_MAX_HEIGHT = 64.0f;
 
-class Game;
+// Geomipmapping, each LOD level draws every stride'th vertex of the chunk grid (strides must divide CHUNK_SIZE).
+// Chunks use the coarsest level whose height error projects to at most TERRAIN_LOD_PIXEL_ERROR pixels on screen
+const int TERRAIN_LOD_LEVELS = 6;
+const int TERRAIN_LOD_STRIDES[TERRAIN_LOD_LEVELS] = { 1, 2, 4, 10, 20, 50 };
+const float TERRAIN_LOD_PIXEL_ERROR = 2.0f;
 
+// Chunk vertices are the grid row by row, followed by a copy of each edge (z = 0, z = CHUNK_SIZE, x = 0, x = CHUNK_SIZE)
+// which the vertex shader lowers into a skirt, hiding cracks between chunks drawn at different LOD levels
+const int TERRAIN_GRID_VERTICES = (CHUNK_SIZE + 1) * (CHUNK_SIZE + 1);
+const int TERRAIN_SKIRT_VERTICES = 4 * (CHUNK_SIZE + 1);
+const int TERRAIN_CHUNK_VERTICES = TERRAIN_GRID_VERTICES + TERRAIN_SKIRT_VERTICES;
 
-// All GPU data needed to render terrain
-struct RenderTerrainObject {
-    GLuint VAO;                 // Vertex array object
-    GLuint VBO;                 // Vertex buffer object
-    GLuint EBO;                 // Element buffer object
+// Water chunks are one quad each, kept in a shared vertex buffer at their chunk slot
+const int WATER_CHUNK_VERTICES = 4;
+const int WATER_CHUNK_INDICES = 6;
 
-    GLuint sandTexture;
-    GLuint sandNormal;
+// Each LOD level is split into a quadtree of sub-patches for frustum culling. Nodes are numbered breadth first
+// (root 0, its children 1-4, theirs 5-20) with siblings in Morton order, so every node's triangles are one contiguous index range
+const int TERRAIN_PATCH_DEPTH = 2;
+const int TERRAIN_PATCH_NODES = 21;
 
-    GLuint grassTexture;
-    GLuint grassNormal;
+// Every chunk shares one 16 bit index buffer, walked in vertical bands of this many tiles so the previous
+// row of a band is still in the post-transform vertex cache (band width + 2 vertices, fits a 16 entry FIFO)
+const int TERRAIN_INDEX_BAND_WIDTH = 14;
+static_assert(TERRAIN_CHUNK_VERTICES <= 65536, "Chunk vertices must be addressable by 16 bit indices");
+const int RENDER_DISTANCE = 1;      // Number of chunks drawn in each direction from the camera
 
-    GLuint rockTexture;
-    GLuint rockNormal;
+// Chunks stay loaded on the GPU this many chunks past RENDER_DISTANCE, so walking back and forth over a border does
+// not reload them. Unloaded chunks' heightfields are kept compressed in memory, then on disk, up to these budgets
+const int CHUNK_UNLOAD_HYSTERESIS = 1;
+const int RESIDENT_DISTANCE = RENDER_DISTANCE + CHUNK_UNLOAD_HYSTERESIS;
+const int MAX_LOADED_CHUNKS = (2 * RESIDENT_DISTANCE + 1) * (2 * RESIDENT_DISTANCE + 1);
+const int HEIGHTMAP_LAYERS = MAX_LOADED_CHUNKS;     // One texture array layer per loaded chunk
+const size_t CHUNK_CACHE_RAM_BUDGET = 16 * 1024 * 1024;     // Bytes of compressed heightfields kept in memory
+const size_t CHUNK_CACHE_DISK_BUDGET = 256 * 1024 * 1024;   // Bytes of compressed heightfields spilled to disk
+const char* const CHUNK_CACHE_DIRECTORY = "chunkcache";
+const float CHUNK_CACHE_HEIGHT_STEP = 1.0f / 4096.0f;       // Height quantization of cached heightfields
 
-    GLuint snowTexture;
-    GLuint snowNormal;
+// Chunks the camera's current velocity would bring into render distance within PREFETCH_LOOKAHEAD seconds are
+// generated early, up to PREFETCH_DISTANCE chunks beyond RENDER_DISTANCE. They are uploaded as soon as they are built
+// and stay loaded, flagged as prefetched, until the camera reaches them, so they have to fit in the hysteresis band
+const float PREFETCH_LOOKAHEAD = 2.0f;
+const int PREFETCH_DISTANCE = 1;
+const int PREFETCH_WINDOW = RENDER_DISTANCE + PREFETCH_DISTANCE;    // Chunks in each direction that can be pending
+static_assert(PREFETCH_DISTANCE <= CHUNK_UNLOAD_HYSTERESIS, "Prefetched chunks must stay within RESIDENT_DISTANCE");
+const int TERRAIN_MAX_DRAWS = MAX_LOADED_CHUNKS * (1 << (2 * TERRAIN_PATCH_DEPTH));     // Indirect draws per frame, at most one per leaf sub-patch
+
+// Cull terrain chunks, pick their LOD levels and build the indirect draws in a compute shader (cullTerrain.comp)
+// instead of on the CPU, so the CPU does no per chunk work each frame. Only a preference, drivers without
+// GL_ARB_indirect_parameters and GL_ARB_shader_draw_parameters fall back to culling on the CPU
+const bool TERRAIN_GPU_CULLING = true;
+const int TERRAIN_CULL_GROUP_SIZE = 64;     // Chunk slots per work group, matches local_size_x in cullTerrain.comp
+
+// Uniform buffer binding points, match the binding of the blocks in the shaders
+const GLuint FRAME_DATA_BINDING = 0;        // FrameData, shared by every program
+const GLuint WATER_CHUNK_BINDING = 1;       // WaterChunkData of the water chunk being drawn
+const int MAX_CHUNK_UPLOADS_PER_FRAME = 2;  // Finished chunks uploaded to the GPU per frame, spreads upload cost across frames
+const int STAGING_RING_SIZE = 4 * 1024 * 1024;  // Bytes of chunk data that can be waiting on the GPU to copy it, uploads wait when full
+// Mapped chunk meshes handed to the worker threads in advance, workers wait for one when all are in use. Enough for every
+// chunk of the prefetch window to be built ahead plus the uploads whose copies are still in flight.
+const int MESH_STAGING_SLOTS = (2 * PREFETCH_WINDOW + 1) * (2 * PREFETCH_WINDOW + 1) + 2 * MAX_CHUNK_UPLOADS_PER_FRAME;
+const float FIELD_OF_VIEW = 45.0f;  // Vertical, in degrees
+const float VIEW_DISTANCE = 500.0f; // Far plane, chunks further away are never drawn
+
+
+class Game;
+struct StagingAllocation;
+
+
+// All GPU data needed to render terrain
+struct RenderTerrainObject {
+    GLuint VAO;                 // Vertex array object, shared by every terrain chunk (not owned)
+    GLuint VBO;                 // Vertex buffer object, shared by every terrain chunk (not owned)
+    GLuint EBO;                 // Element buffer object, shared by every terrain chunk (not owned)
+    int baseVertex;             // First of the chunk's vertices in the shared vertex buffer, -1 in heightmap mode
 
-    unsigned int indexCount;    // Number of indices to draw
     mat4 modelMatrix;           // Model transformation
+    int heightmapLayer;         // Texture array layer holding the chunk's heights (TERRAIN_HEIGHTMAP_TEXTURE only)
+    int lod;                    // LOD level to draw, chosen every frame
+    float skirtDepth;           // How far the skirt hangs below the chunk's edges, enough to cover any neighbour's LOD error
 
     RenderTerrainObject() : 
-        VAO(0), VBO(0), EBO(0), 
-        sandTexture(0), sandNormal(0),
-        grassTexture(0), grassNormal(0),
-        rockTexture(0), rockNormal(0),
-        snowTexture(0), snowNormal(0),
-        indexCount(0), modelMatrix(mat4(1.0f))
+        VAO(0), VBO(0), EBO(0), baseVertex(-1),
+        modelMatrix(mat4(1.0f)),
+        heightmapLayer(-1),
+        lod(0), skirtDepth(0.0f)
     {}
 
     void SetPosition(const vec3& pos) {
@@ -62,12 +131,14 @@ struct RenderWaterObject {
     GLuint VAO;                 // Vertex array object
     GLuint VBO;                 // Vertex buffer object
     GLuint EBO;                 // Element buffer object
+    int baseVertex;             // First of the chunk's vertices in the shared vertex buffer
     GLuint texture;             // Texture ID
     unsigned int indexCount;    // Number of indices to draw
     mat4 modelMatrix;           // Model transformation
     float alpha;                // Transparency alpha value
+    GLintptr dataOffset;        // Offset of the chunk's WaterChunkData in the water chunk uniform buffer
 
-    RenderWaterObject() : VAO(0), VBO(0), EBO(0), texture(0), indexCount(0), modelMatrix(mat4(1.0f)), alpha(1.0f) {}
+    RenderWaterObject() : VAO(0), VBO(0), EBO(0), baseVertex(0), texture(0), indexCount(0), modelMatrix(mat4(1.0f)), alpha(1.0f), dataOffset(0) {}
 
     void SetPosition(const vec3& pos) {
         modelMatrix = translate(modelMatrix, pos);
@@ -78,12 +149,157 @@ struct RenderWaterObject {
     }
 };
 
+// Chunk heights sampled on the vertex grid plus a one sample apron, read-only (and shared between threads) once built
+struct ChunkHeightfield {
+    int chunkX;
+    int chunkZ;
+    vector<float> heights;      // HEIGHTFIELD_SIZE * HEIGHTFIELD_SIZE samples, row by row
+    float minHeight;            // Height range of the chunk's own vertices, apron excluded
+    float maxHeight;
+    float lodError[TERRAIN_LOD_LEVELS];     // Largest height difference between the full grid and each LOD level
+
+    // Height range of each culling sub-patch, per LOD level as the patch edges snap to that level's stride
+    float patchMinHeight[TERRAIN_LOD_LEVELS][TERRAIN_PATCH_NODES];
+    float patchMaxHeight[TERRAIN_LOD_LEVELS][TERRAIN_PATCH_NODES];
+
+    ChunkHeightfield() : chunkX(0), chunkZ(0), minHeight(0.0f), maxHeight(0.0f), lodError(), patchMinHeight(), patchMaxHeight() {}
+
+    // Vertex grid coordinates, -1 and CHUNK_SIZE + 1 address the apron
+    float At(int x, int z) const { return heights[(z + 1) * HEIGHTFIELD_SIZE + (x + 1)]; }
+};
+
+// Heightfields of already loaded neighbouring chunks, any of which may be null
+struct ChunkNeighbours {
+    shared_ptr<const ChunkHeightfield> left;    // chunkX - 1
+    shared_ptr<const ChunkHeightfield> right;   // chunkX + 1
+    shared_ptr<const ChunkHeightfield> down;    // chunkZ - 1
+    shared_ptr<const ChunkHeightfield> up;      // chunkZ + 1
+};
+
+// Compact terrain vertex, see TERRAIN_COMPACT_VERTICES
+struct CompactTerrainVertex {
+    uint16_t height;            // Normalised between TERRAIN_MIN_HEIGHT and TERRAIN_MAX_HEIGHT
+    uint8_t normal[2];          // Octahedral encoded unit normal
+};
+
+// Bytes per vertex in the shared terrain vertex buffer
+const int TERRAIN_VERTEX_SIZE = TERRAIN_RENDER_MODE == TERRAIN_COMPACT_VERTICES ? sizeof(CompactTerrainVertex) : 8 * sizeof(float);
+static_assert(HEIGHTFIELD_SIZE * HEIGHTFIELD_SIZE * sizeof(float) <= STAGING_RING_SIZE, "A chunk's heightfield must fit in the staging ring");
+
+// Terrain mesh built on a worker thread straight into mapped staging memory, before being uploaded by CreateTerrain
+struct TerrainMeshData {
+    int chunkX;
+    int chunkZ;
+    void* vertices;             // TERRAIN_CHUNK_VERTICES vertices, interleaved position, normal, texture or compact. Null for TERRAIN_HEIGHTMAP_TEXTURE
+    int stagingSlot;            // Mesh staging slot holding the vertices, -1 when there are none
+    shared_ptr<const ChunkHeightfield> heightfield;
+
+    TerrainMeshData() : chunkX(0), chunkZ(0), vertices(nullptr), stagingSlot(-1) {}
+};
+
+// One culling sub-patch of a terrain LOD level, the same for every chunk
+struct TerrainPatch {
+    int x0, z0;                 // Extent in tiles from the chunk origin
+    int x1, z1;
+    unsigned int firstIndex;    // Range of the shared terrain index buffer, skirts included
+    unsigned int indexCount;    // 0 when the level is too coarse to split this far
+};
+
+// One draw of glMultiDrawElementsIndirect, layout fixed by OpenGL
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Per frame shader data, written once per frame into one uniform buffer every program reads (std140 layout, matches
+// the FrameData block in the shaders)
+struct FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    float lightIntensity;
+    float timer;                // Seconds since the start, animates the water
+    float padding[2];
+};
+static_assert(sizeof(FrameData) % 16 == 0, "FrameData must match its std140 block size");
+
+// Per chunk water data, one entry per chunk slot bound as a range for each water draw (std140 layout, matches the
+// WaterChunk block in the water shaders)
+struct WaterChunkData {
+    mat4 model;
+    float alpha;
+    float padding[3];
+};
+static_assert(sizeof(WaterChunkData) % 16 == 0, "WaterChunkData must match its std140 block size");
+
+// Per draw terrain data, read by the vertex shader through gl_DrawID (std430 layout, matches vertexShader.vert)
+struct TerrainDrawData {
+    mat4 model;
+    vec4 chunk;                 // Chunk origin x, chunk origin z, skirt depth, heightmap layer
+};
+
+// Per chunk data read by the GPU culling pass, one entry per chunk slot (std430 layout, matches cullTerrain.comp)
+struct TerrainChunkData {
+    mat4 model;
+    vec4 boundsMin;             // Chunk bounds, skirts excluded. boundsMin.w is 1 when the slot holds a chunk
+    vec4 boundsMax;
+    ivec4 info;                 // Base vertex, heightmap layer, unused, unused
+    ivec4 neighbours;           // Slots of the chunks at x - 1, x + 1, z - 1, z + 1, -1 when not loaded
+    float lodError[8];          // First TERRAIN_LOD_LEVELS used
+    vec2 patchHeights[TERRAIN_LOD_LEVELS * TERRAIN_PATCH_NODES];    // Min and max height of every culling sub-patch
+};
+static_assert(TERRAIN_LOD_LEVELS <= 8, "TerrainChunkData holds at most 8 LOD errors");
+static_assert(sizeof(TerrainChunkData) % 16 == 0, "TerrainChunkData must match its std430 array stride");
+
 // Data needed for each terrain chunk
 struct TerrainChunk {
     RenderTerrainObject terrain;
     RenderWaterObject water;
+    shared_ptr<const ChunkHeightfield> heightfield;
     int chunkX;
     int chunkZ;
+    int slot;                   // Index of the chunk's GPU culling entry and heightmap layer, 0 to MAX_LOADED_CHUNKS - 1
+    bool prefetched;            // Loaded before it was within render distance, and not needed yet
+};
+
+// Terrain chunk that passed frustum culling, with the index ranges of its visible sub-patches
+struct VisibleTerrainChunk {
+    int record;                 // Into the game's render list
+    int firstRange;             // Into the game's terrain draw commands
+    int rangeCount;
+    bool whole;                 // Entirely inside the frustum, the only range is the LOD level's root patch
+};
+
+// Chunk requested from the worker threads but not yet uploaded
+struct PendingChunk {
+    chrono::steady_clock::time_point requested;     // When the chunk was requested, or when a prefetched chunk was first needed
+    bool prefetched;            // Requested before it was within render distance, and not needed yet
+
+    PendingChunk() : prefetched(false) {}
+    PendingChunk(chrono::steady_clock::time_point requested, bool prefetched) : requested(requested), prefetched(prefetched) {}
+};
+
+// Prefetching results, counted as chunks come into render distance, for tuning PREFETCH_LOOKAHEAD
+struct PrefetchStats {
+    int hits;                   // Already built, or being built, by the time they were needed
+    int misses;                 // Only requested once needed
+    int wasted;                 // Prefetched chunks dropped without ever being needed
+
+    PrefetchStats() : hits(0), misses(0), wasted(0) {}
+};
+
+// Frustum culling results of the last frame, for benchmarking
+struct CullingStats {
+    int terrainChunksDrawn;
+    int terrainChunksCulled;
+    int terrainPatchesCulled;   // Sub-patches skipped inside partly visible chunks
+    int waterChunksDrawn;
+    int waterChunksCulled;
+
+    CullingStats() : terrainChunksDrawn(0), terrainChunksCulled(0), terrainPatchesCulled(0), waterChunksDrawn(0), waterChunksCulled(0) {}
 };
 
 // Unique key used to identify each terrain chunk
@@ -91,45 +307,97 @@ struct ChunkKey {
     int x;
     int z;
 
-    // Unordered map key comparison
+    // Key comparison
     bool operator==(const ChunkKey& other) const {
         return (x == other.x) && (z == other.z);
     }
 };
 
-// Combines x and z coords into single hash value
-struct ChunkKeyHash {
-    size_t operator()(const ChunkKey& key) const {
-        // Calculate hashes
-        size_t hashX = hash<int>{}(key.x);
-        size_t hashZ = hash<int>{}(key.z);
-
-        // Combine hashes
-        return hashX ^ (hashZ << 1);
-    }
-};
-
 
 // Window resize logic
 void FramebufferSizeCallback(GLFWwindow* window, int width, int height);
 
-// Function to create textured flat terrain chunk
+// Function to sample a chunk's heights, copying border samples from loaded neighbours instead of regenerating them
+shared_ptr<ChunkHeightfield> BuildHeightfield(int chunkX, int chunkZ, const ChunkNeighbours& neighbours);
+
+// Function to fill in a heightfield's height range, LOD errors and sub-patch bounds from its heights
+void MeasureHeightfield(ChunkHeightfield& field);
+
+// Function to measure the largest vertical error of drawing a heightfield with only every stride'th vertex
+float MeasureLodError(const ChunkHeightfield& field, int stride);
+
+// Function to get the tile extent of a culling sub-patch, for the LOD level with the given stride
+void GetTerrainPatchExtent(int gridWidth, int gridDepth, int stride, int node, int& x0, int& z0, int& x1, int& z1);
+
+// Function to measure the height range of every culling sub-patch of a heightfield
+void MeasurePatchHeights(ChunkHeightfield& field);
+
+// Function to generate terrain chunk mesh data from its heightfield, safe to call from worker threads. Writes
+// TERRAIN_CHUNK_VERTICES vertices of TERRAIN_VERTEX_SIZE bytes to 16 byte aligned (usually mapped) memory at
+// vertices with non-temporal stores, which may be null for TERRAIN_HEIGHTMAP_TEXTURE
+TerrainMeshData BuildTerrainMesh(const shared_ptr<const ChunkHeightfield>& heightfield, void* vertices);
+
+// Function to pack a height and unit normal into a compact terrain vertex
+CompactTerrainVertex PackTerrainVertex(float height, const vec3& normal);
+
+// Function to generate triangle indices for one LOD level of a chunk vertex grid plus its skirts, sub-patch by
+// sub-patch in cache friendly bands (see TERRAIN_INDEX_BAND_WIDTH). Fills in the range of each sub-patch.
+vector<uint16_t> BuildTerrainIndices(int gridWidth, int gridDepth, int stride, TerrainPatch* patches);
+
+// Function to upload the terrain index buffer shared by every chunk, holding every LOD level one after another.
+// Fills in TERRAIN_PATCH_NODES sub-patches per level.
+GLuint CreateTerrainIndexBuffer(int gridWidth, int gridDepth, vector<TerrainPatch>& patches);
+
+// Function to create a buffer holding 0 to maxDraws - 1, the draw index attribute of drivers without gl_DrawID
+GLuint CreateDrawIndexBuffer(int maxDraws);
+
+// Function to create the vertex array every terrain chunk is drawn with. Outside heightmap mode it also creates
+// one vertex buffer with room for maxChunks chunk meshes, which chunks are given ranges of. A non zero drawIndexBuffer
+// is read as a per instance draw index
+GLuint CreateTerrainVertexArray(GLuint indexBuffer, GLuint& vertexBuffer, GLuint drawIndexBuffer, int maxChunks);
+
+// Function to upload generated terrain chunk mesh into its range of the shared vertex buffer, copying it on the GPU
+// from the staging space the mesh was built in, must be called on the GL thread
 RenderTerrainObject CreateTerrain(
-    int gridWidth, int gridDepth, float tileSize, int chunkX, int chunkZ,
-    GLuint sandTexture, GLuint sandNormal,
-    GLuint grassTexture, GLuint grassNormal,
-    GLuint rockTexture, GLuint rockNormal,
-    GLuint snowTexture, GLuint snowNormal
+    const StagingAllocation& staging,
+    GLuint vertexArray, GLuint vertexBuffer, int baseVertex,
+    GLuint indexBuffer
+);
+
+// Function to create the texture array holding one chunk heightfield per layer
+GLuint CreateHeightmapArray(int layers);
+
+// Function to upload a chunk's heightfield into a layer of the heightmap array through staging space of
+// HEIGHTFIELD_SIZE * HEIGHTFIELD_SIZE floats, must be called on the GL thread
+RenderTerrainObject CreateHeightmapTerrain(
+    const ChunkHeightfield& field,
+    const StagingAllocation& staging,
+    GLuint heightmapArray, int layer,
+    GLuint vertexArray, GLuint indexBuffer
 );
 
-// Function to create textured flat water
-RenderWaterObject CreateWater(int gridWidth, int gridDepth, float tileSize, int chunkX, int chunkZ, float alpha, GLuint waterTexture);
+// Function to create the vertex array every water chunk is drawn with, along with a vertex buffer holding one quad
+// for each of maxChunks chunk slots and the index buffer they share
+GLuint CreateWaterVertexArray(GLuint& vertexBuffer, GLuint& indexBuffer, int maxChunks);
+
+// Function to create textured flat water, filling its quad in at baseVertex of the shared water vertex buffer and its
+// WaterChunkData in at dataOffset of the water chunk uniform buffer
+RenderWaterObject CreateWater(
+    int gridWidth, int gridDepth, float tileSize, int chunkX, int chunkZ, float alpha, GLuint waterTexture,
+    GLuint vertexArray, GLuint vertexBuffer, int baseVertex, GLuint indexBuffer,
+    GLuint dataBuffer, GLintptr dataOffset
+);
 
 // Function generate y values for terrain mapping
 float GenerateHeight(float x, float z);
 
-// Function generate normal values
-vec3 GenerateNormal(float x, float z);
-
 // Load texture image from given file location
 GLuint LoadTexture(const string& texturePath);
+
+// Load texture images from given file locations into the layers of a mipmapped texture array, in order. Images are
+// resampled to the size of the largest, a layer whose image is missing is left black as a missing texture would sample
+GLuint LoadTexture(const vector<string>& texturePaths);
+
+// Function to resample a tiling RGB image to another size, bilinear when enlarging and a tent filter over every
+// source texel a destination texel covers when shrinking
+vector<unsigned char> ResampleImage(const unsigned char* data, int width, int height, int newWidth, int newHeight);
@@ -1,4 +1,4 @@
-#version 460
+#version 450
 
 // Output colour value
 out vec4 FragColor;
@@ -8,30 +8,29 @@ in vec3 positionFrag;
 in vec3 normalFrag;
 in vec2 textureFrag;
 
-// Diffuse (texture) maps
-uniform sampler2D sandDiffuse;
-uniform sampler2D grassDiffuse;
-uniform sampler2D rockDiffuse;
-uniform sampler2D snowDiffuse;
+// Material maps, one layer per material from lowest to highest: sand, grass, rock, snow
+uniform sampler2DArray materialDiffuse;
+uniform sampler2DArray materialNormal;
 
-// Normal maps
-uniform sampler2D sandNormal;
-uniform sampler2D grassNormal;
-uniform sampler2D rockNormal;
-uniform sampler2D snowNormal;
+// Per frame data, matches FrameData in main.h
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    float lightIntensity;
+    float timer;
+};
 
 // Lighting
 uniform vec3 lightDir = normalize(vec3(0.5f, -1.0f, 0.3f));
-uniform float lightIntensity;
 uniform float ambientStrength = 0.3f;
 
-// Height thresholds
-const float sandHeight  = -10.0f;
-const float grassHeight = 2.0f;
-const float rockHeight  = 13.0f;
-const float snowHeight  = 23.0f;
+// Heights the blend between each material and the next is centred on (sand to grass, grass to rock, rock to snow)
+const float materialTransitions[3] = float[3](-10.0f, 2.0f, 13.0f);
+const int MATERIAL_LAYERS = 4;
 
-// Blending band width between textures
+// Blending band width between textures. Transitions are at least two band widths apart, so bands never overlap
+// and at most two neighbouring materials contribute to any fragment
 const float blendWidth = 5.0f;
 
 
@@ -43,47 +42,30 @@ float Blend(float centre, float height) {
 void main() {
     float height = positionFrag.y;
 
-    // Transition values
-    float sandToGrass = Blend(sandHeight, height);
-    float grassToRock = Blend(grassHeight, height);
-    float rockToSnow  = Blend(rockHeight, height);
-
-    // Blend weights
-    float sandWeight = 1.0f - sandToGrass;
-    float grassWeight = sandToGrass * (1.0f - grassToRock);
-    float rockWeight = grassToRock * (1.0f - rockToSnow);
-    float snowWeight = rockToSnow;
-
-    // Normalise weights
-    float total = sandWeight + grassWeight + rockWeight + snowWeight;
-    sandWeight /= total;
-    grassWeight /= total;
-    rockWeight /= total;
-    snowWeight /= total;
-
-    // Sample diffuse textures
-    vec3 sandColour = texture(sandDiffuse, textureFrag).rgb;
-    vec3 grassColour = texture(grassDiffuse, textureFrag).rgb;
-    vec3 rockColour = texture(rockDiffuse, textureFrag).rgb;
-    vec3 snowColour = texture(snowDiffuse, textureFrag).rgb;
-
-    vec3 finalColour =
-        sandColour * sandWeight +
-        grassColour * grassWeight +
-        rockColour * rockWeight +
-        snowColour * snowWeight;
-
-    // Sample normal maps
-    vec3 sandNormalMap = texture(sandNormal, textureFrag).rgb * 2.0f - 1.0f;
-    vec3 grassNormalMap = texture(grassNormal, textureFrag).rgb * 2.0f - 1.0f;
-    vec3 rockNormalMap = texture(rockNormal, textureFrag).rgb * 2.0f - 1.0f;
-    vec3 snowNormalMap = texture(snowNormal, textureFrag).rgb * 2.0f - 1.0f;
-
-    vec3 blendedNormal =
-        sandNormalMap * sandWeight +
-        grassNormalMap * grassWeight +
-        rockNormalMap * rockWeight +
-        snowNormalMap * snowWeight;
+    // Lowest material still contributing, every transition band below the fragment has been passed
+    int lower = 0;
+    for (int i = 0; i < MATERIAL_LAYERS - 1; i++) {
+        if (height >= materialTransitions[i] + blendWidth) {
+            lower = i + 1;
+        }
+    }
+    int upper = min(lower + 1, MATERIAL_LAYERS - 1);
+
+    // Weight of the material above it, zero for the top material
+    float upperWeight = lower < MATERIAL_LAYERS - 1 ? Blend(materialTransitions[lower], height) : 0.0f;
+
+    // Only the two contributing layers are sampled
+    vec3 finalColour = mix(
+        texture(materialDiffuse, vec3(textureFrag, lower)).rgb,
+        texture(materialDiffuse, vec3(textureFrag, upper)).rgb,
+        upperWeight
+    );
+
+    vec3 blendedNormal = mix(
+        texture(materialNormal, vec3(textureFrag, lower)).rgb,
+        texture(materialNormal, vec3(textureFrag, upper)).rgb,
+        upperWeight
+    ) * 2.0f - 1.0f;
 
     vec3 finalNormal = normalize(normalFrag + blendedNormal);
 
@@ -1,25 +1,146 @@
-#version 460
+#version 450
+#extension GL_ARB_shader_draw_parameters : enable
 
 // Vertex attributes
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texture;
 
+// Compact vertex attributes (used instead of the above in TERRAIN_COMPACT_VERTICES mode)
+layout (location = 3) in float packedHeight;
+layout (location = 4) in vec2 packedNormal;
+
+// Index of the draw into draws. Without gl_DrawID it comes from a per instance attribute, each draw's baseInstance
+// holds its index
+#ifdef GL_ARB_shader_draw_parameters
+#define DRAW_INDEX gl_DrawIDARB
+#else
+layout (location = 5) in uint drawIndex;
+#define DRAW_INDEX int(drawIndex)
+#endif
+
 // Outputs to fragmentShader
 out vec3 positionFrag;
 out vec3 normalFrag;
 out vec2 textureFrag;
 
-// Uniforms
-uniform mat4 mvpIn;
-uniform mat4 model;
+// Per draw chunk data, every chunk is drawn by one glMultiDrawElementsIndirect call, matches TerrainDrawData in main.h
+struct TerrainDrawData {
+    mat4 model;
+    vec4 chunk;                 // Chunk origin x, chunk origin z, skirt depth, heightmap layer
+};
+layout (std430, binding = 0) readonly buffer TerrainDraws {
+    TerrainDrawData draws[];
+};
+
+// Per frame data, matches FrameData in main.h
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    float lightIntensity;
+    float timer;
+};
+
+// Terrain storage modes, match TerrainRenderMode in main.h
+const int TERRAIN_COMPACT_VERTICES = 1;
+const int TERRAIN_HEIGHTMAP_TEXTURE = 2;
+
+// Compact and heightmap vertex reconstruction
+uniform int terrainMode;
+uniform int gridSize;           // Tiles per chunk side (vertices per side - 1)
+uniform float tileSize;
+uniform vec2 heightRange;       // Min and max height the packed height is normalised between
+uniform sampler2DArray heightmap;   // One chunk heightfield per layer, including a one texel apron
+
+
+// Unpack an octahedral encoded normal (y is the octahedron's axis)
+vec3 DecodeOctahedral(vec2 encoded) {
+    vec2 p = encoded * 2.0f - 1.0f;
+    vec3 n = vec3(p.x, 1.0f - abs(p.x) - abs(p.y), p.y);
+
+    // Unfold the lower hemisphere
+    if (n.y < 0.0f) {
+        n.xz = (1.0f - abs(n.zx)) * vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.z >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    return normalize(n);
+}
+
+// Grid position of a vertex, skirt vertices (stored after the grid, one copy of each edge) map back to
+// the edge vertex they hang from
+ivec2 GridPosition(int vertexID, out bool skirt) {
+    int gridVertices = (gridSize + 1) * (gridSize + 1);
+    skirt = vertexID >= gridVertices;
+    if (!skirt) {
+        return ivec2(vertexID % (gridSize + 1), vertexID / (gridSize + 1));
+    }
+
+    int edge = (vertexID - gridVertices) / (gridSize + 1);
+    int i = (vertexID - gridVertices) % (gridSize + 1);
+    if (edge == 0) return ivec2(i, 0);
+    if (edge == 1) return ivec2(i, gridSize);
+    if (edge == 2) return ivec2(0, i);
+    return ivec2(gridSize, i);
+}
+
+// Read a height from the heightmap, grid coordinates -1 and gridSize + 1 address the apron
+float HeightAt(int x, int z, int layer) {
+    return texelFetch(heightmap, ivec3(x + 1, z + 1, layer), 0).r;
+}
 
 
 void main() {
-    positionFrag = vec3(model * vec4(position, 1.0f));
-    normalFrag = normalize(mat3(transpose(inverse(model))) * normal);
-    textureFrag = texture;
+    TerrainDrawData draw = draws[DRAW_INDEX];
+    mat4 model = draw.model;
+    vec2 chunkOrigin = draw.chunk.xy;
+
+    vec3 vertexPosition = position;
+    vec3 vertexNormal = normal;
+    vec2 vertexTexture = texture;
+
+    // Vertices are stored row by row, so the index within the chunk's range of the vertex buffer gives the grid position
+    bool skirt;
+    ivec2 gridPosition = GridPosition(gl_VertexID - gl_BaseVertexARB, skirt);
+    int x = gridPosition.x;
+    int z = gridPosition.y;
+
+    if (terrainMode == TERRAIN_COMPACT_VERTICES) {
+        vertexPosition = vec3(
+            chunkOrigin.x + x * tileSize,
+            mix(heightRange.x, heightRange.y, packedHeight),
+            chunkOrigin.y + z * tileSize
+        );
+        vertexNormal = DecodeOctahedral(packedNormal);
+        vertexTexture = vertexPosition.xz;
+    }
+    else if (terrainMode == TERRAIN_HEIGHTMAP_TEXTURE) {
+        int layer = int(draw.chunk.w);
+
+        vertexPosition = vec3(
+            chunkOrigin.x + x * tileSize,
+            HeightAt(x, z, layer),
+            chunkOrigin.y + z * tileSize
+        );
+
+        // Central differences, the same as the CPU mesh builder
+        vertexNormal = normalize(vec3(
+            HeightAt(x - 1, z, layer) - HeightAt(x + 1, z, layer),
+            2.0f * tileSize,
+            HeightAt(x, z - 1, layer) - HeightAt(x, z + 1, layer)
+        ));
+        vertexTexture = vertexPosition.xz;
+    }
+
+    // Hang skirts below the chunk's edge to hide cracks next to chunks drawn at a different LOD
+    if (skirt) {
+        vertexPosition.y -= draw.chunk.z;
+    }
+
+    positionFrag = vec3(model * vec4(vertexPosition, 1.0f));
+    normalFrag = normalize(mat3(transpose(inverse(model))) * vertexNormal);
+    textureFrag = vertexTexture;
 
     // Transformation applied to vertices
-    gl_Position = mvpIn * vec4(position, 1.0f);
+    gl_Position = viewProjection * model * vec4(vertexPosition, 1.0f);
 }
@@ -1,4 +1,4 @@
-#version 460
+#version 450
 
 // Colour value to send to next stage
 out vec4 FragColor;
@@ -9,11 +9,20 @@ in vec2 textureCoordinatesFrag;
 // Texture (colours)
 uniform sampler2D textureIn;
 
-// Alpha transparency value
-uniform float waterAlpha;
-
-// Light intensity based on day/night cycle
-uniform float lightIntensity;
+// Per frame data, matches FrameData in main.h
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    float lightIntensity;
+    float timer;
+};
+
+// Per chunk data, matches WaterChunkData in main.h
+layout (std140, binding = 1) uniform WaterChunk {
+    mat4 model;
+    float waterAlpha;           // Transparency
+};
 
 
 void main() {
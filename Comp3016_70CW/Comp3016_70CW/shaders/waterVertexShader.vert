@@ -1,4 +1,4 @@
-#version 460
+#version 450
 
 // Vertex attributes
 layout (location = 0) in vec3 position;
@@ -7,9 +7,20 @@ layout (location = 1) in vec2 textureCoordinatesVertex;
 // Texture coordinates to send
 out vec2 textureCoordinatesFrag;
 
-// Inputs from main
-uniform mat4 mvpIn;
-uniform float timer;
+// Per frame data, matches FrameData in main.h
+layout (std140, binding = 0) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    float lightIntensity;
+    float timer;
+};
+
+// Per chunk data, matches WaterChunkData in main.h
+layout (std140, binding = 1) uniform WaterChunk {
+    mat4 model;
+    float waterAlpha;           // Transparency
+};
 
 // Wave variables
 uniform float waveAmplitude = 0.2f;     // Height of waves
@@ -24,7 +35,7 @@ void main() {
     displacedPos.y += cos(displacedPos.z * waveFrequency + timer * waveSpeed) * waveAmplitude;
 
     // Transformation applied to vertices
-    gl_Position = mvpIn * vec4(displacedPos, 1.0);
+    gl_Position = viewProjection * model * vec4(displacedPos, 1.0);
 
     // Sending texture coordinates to next stage
     textureCoordinatesFrag = textureCoordinatesVertex;